@@ -0,0 +1,125 @@
+# compiles the files of the client web app into a C++ source file, so the server serves them from memory
+#
+# the files other than the HTML pages get a second path with a hash of their content in it,
+# and the pages refer to them by that path, so the browsers can keep them without revalidating
+#
+# usage: cmake -DCLIENT_DIR=<client-dir> -DOUTPUT=<output-cpp> -P embed_client.cmake
+
+if (NOT CLIENT_DIR OR NOT OUTPUT)
+    message(FATAL_ERROR "CLIENT_DIR and OUTPUT must be set")
+endif()
+
+file(GLOB_RECURSE client_files RELATIVE ${CLIENT_DIR} ${CLIENT_DIR}/*)
+list(SORT client_files)
+
+# the content-hashed paths of the assets the pages refer to
+set(hashed_from "")
+set(hashed_to "")
+
+foreach(file IN LISTS client_files)
+    if (NOT file MATCHES "\\.html?$")
+        file(SHA256 ${CLIENT_DIR}/${file} hash)
+        string(SUBSTRING ${hash} 0 16 hash)
+
+        get_filename_component(dir ${file} DIRECTORY)
+        get_filename_component(name ${file} NAME_WLE)
+        get_filename_component(ext ${file} LAST_EXT)
+
+        if (dir)
+            set(hashed_path "/${dir}/${name}.${hash}${ext}")
+        else()
+            set(hashed_path "/${name}.${hash}${ext}")
+        endif()
+
+        list(APPEND hashed_from "/${file}")
+        list(APPEND hashed_to ${hashed_path})
+    endif()
+endforeach()
+
+list(LENGTH hashed_from hashed_count)
+
+set(arrays "")
+set(entries "")
+set(paths "")
+set(asset_count 0)
+set(index 0)
+
+foreach(file IN LISTS client_files)
+    set(source ${CLIENT_DIR}/${file})
+
+    # the pages refer to the other assets by their hashed paths
+    if (file MATCHES "\\.html?$" AND hashed_count GREATER 0)
+        file(READ ${source} content)
+
+        math(EXPR last "${hashed_count} - 1")
+        foreach(i RANGE ${last})
+            list(GET hashed_from ${i} from)
+            list(GET hashed_to ${i} to)
+            string(REPLACE "\"${from}\"" "\"${to}\"" content "${content}")
+        endforeach()
+
+        set(source ${OUTPUT}.page)
+        file(WRITE ${source} "${content}")
+    endif()
+
+    file(READ ${source} hex HEX)
+    string(LENGTH "${hex}" hex_length)
+
+    if (hex_length EQUAL 0)
+        set(body "std::string_view()")
+    else()
+        string(REGEX REPLACE "([0-9a-f][0-9a-f])" "'\\\\x\\1'," bytes "${hex}")
+        string(APPEND arrays "constexpr char asset_${index}[] = { ${bytes} };\n")
+        set(body "std::string_view(asset_${index}, sizeof(asset_${index}))")
+    endif()
+
+    string(APPEND entries "    { \"/${file}\", ${body}, false },\n")
+    string(APPEND paths "    \"/${file}\",\n")
+    math(EXPR asset_count "${asset_count} + 1")
+
+    list(FIND hashed_from "/${file}" hashed_index)
+    if (NOT hashed_index EQUAL -1)
+        list(GET hashed_to ${hashed_index} to)
+        string(APPEND entries "    { \"${to}\", ${body}, true },\n")
+        string(APPEND paths "    \"${to}\",\n")
+        math(EXPR asset_count "${asset_count} + 1")
+    endif()
+
+    math(EXPR index "${index} + 1")
+endforeach()
+
+file(REMOVE ${OUTPUT}.page)
+
+file(WRITE ${OUTPUT}.tmp
+"// generated from the client directory by cmake/embed_client.cmake, don't edit
+
+#include <array>
+
+#include \"embedded_client.hpp\"
+#include \"perfect_hash_table.hpp\"
+
+namespace {
+
+${arrays}
+constexpr std::array<embedded_asset, ${asset_count}> assets = {{
+${entries}}};
+
+constexpr std::array<std::string_view, ${asset_count}> paths = {
+${paths}};
+
+constexpr perfect_hash_table<${asset_count}> path_table(paths);
+
+}
+
+std::span<const embedded_asset> get_embedded_assets() {
+    return assets;
+}
+
+std::size_t find_embedded_asset(std::string_view path) {
+    return path_table.find(path);
+}
+")
+
+# only touch the output if it changed, so the server isn't rebuilt needlessly
+execute_process(COMMAND ${CMAKE_COMMAND} -E copy_if_different ${OUTPUT}.tmp ${OUTPUT})
+file(REMOVE ${OUTPUT}.tmp)
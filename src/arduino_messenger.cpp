@@ -3,11 +3,12 @@
 arduino_messenger::arduino_messenger(
 	net::io_context& io,
 	std::string_view device_name,
-	unsigned int baud_rate
-) : com(io)
+	serial_options options
+) : com(net::make_strand(io), device_name, options),
+	reconnect_timer(com.get_executor())
 {
 	boost::system::error_code error;
-	com.open(std::string(device_name), error);
+	open_port(error);
 
 	if (error) {
 		if (error == boost::system::errc::device_or_resource_busy)
@@ -17,29 +18,151 @@ arduino_messenger::arduino_messenger(
 		throw open_error(error.message().c_str());
 	}
 
-	com.set_option(
-		net::serial_port_base::baud_rate(baud_rate)
-	);
-	// enable DTR (Data Terminal Ready) for reading from the COM-port to work
-	com.set_option(
-		net::serial_port_base::flow_control(
-			net::serial_port_base::flow_control::hardware
-		)
-	);
+	telemetry.record_byte_transmission_time(com.byte_transmission_time());
+}
+
+void arduino_messenger::open_port(boost::system::error_code& error) {
+	com.open(error);
 }
 
 void arduino_messenger::run() {
 	// read from COM-port indefinitely
 	do_read();
 
-	// try to empty outgoing message queue
-	do_write();
+	// send the messages queued before the start, if there are any
+	net::post(
+		com.get_executor(),
+		[self = shared_from_this()] {
+			if (!self->is_writing) {
+				self->do_write();
+			}
+		}
+	);
 }
 
-void arduino_messenger::do_read() {
-	net::streambuf::mutable_buffers_type temp_mut_buf = buffer.prepare(MAX_MESSAGE_LENGTH);
+void arduino_messenger::on_link_lost(const boost::system::error_code& ec) {
+	// the other operation on the port already noticed
+	if (!is_available) {
+		return;
+	}
+
+	std::cerr << "Lost connection to the device on " << com.get_device_name() << ": " << ec.message() << std::endl;
+
+	is_available = false;
+	telemetry.record_availability(false);
+	link_lost_time = clock::now();
+	reconnect_delay = INITIAL_RECONNECT_DELAY;
 
-	com.async_read_some(net::buffer(temp_mut_buf),
+	// cancels the other pending operation on the port
+	com.close();
+
+	push_incoming(json_message(json_message::Availability, { { "available", false } }));
+
+	do_reconnect();
+}
+
+void arduino_messenger::do_reconnect() {
+	reconnect_timer.expires_after(reconnect_delay);
+	reconnect_timer.async_wait(
+		beast::bind_front_handler(
+			&arduino_messenger::on_reconnect_timer,
+			shared_from_this()
+		)
+	);
+}
+
+void arduino_messenger::on_reconnect_timer(const boost::system::error_code& ec) {
+	if (ec) {
+		return;
+	}
+
+	boost::system::error_code open_ec;
+	open_port(open_ec);
+
+	if (open_ec) {
+		com.close();
+
+		reconnect_delay = std::min(reconnect_delay * 2, MAX_RECONNECT_DELAY);
+		do_reconnect();
+		return;
+	}
+
+	const auto recovery_time =
+		std::chrono::duration_cast<std::chrono::milliseconds>(
+			clock::now() - link_lost_time
+		);
+	std::cout << "Reconnected to the device on " << com.get_device_name() << " in " << recovery_time.count() << " ms." << std::endl;
+
+	is_available = true;
+	telemetry.record_availability(true);
+	frame_reader.clear();
+	partial_read_time.reset();
+
+	{
+		std::lock_guard lock(omq_mutex);
+
+		// the commands the device may have missed, including the ones replayed after an earlier
+		// reconnect that weren't written before the link was lost again
+		std::vector<queued_message> commands;
+		for (const queued_message& command : in_flight_commands) {
+			if (command.message.type == json_message::ChangeState || command.message.type == json_message::ChangeStateBatch) {
+				commands.push_back(command);
+			}
+		}
+		for (const queued_message& command : resync_queue) {
+			if (command.message.type == json_message::ChangeState || command.message.type == json_message::ChangeStateBatch) {
+				commands.push_back(command);
+			}
+		}
+		resync_queue.clear();
+
+		// the device may have been reset, so it's configured again first
+		if (device_config) {
+			resync_queue.push_back({ json_message(json_message::Config, device_config.value()), clock::now(), Urgent, "", std::nullopt, nullptr });
+		}
+
+		// then the commands are replayed in their original order, ahead of everything queued
+		// while the link was down, so an older command never runs after a newer one
+		for (auto it = commands.begin(); it != commands.end(); it++) {
+			// only the last command for each gate matters,
+			// batches are replayed whole, in order with the other commands
+			const bool superseded = it->message.type == json_message::ChangeState && std::any_of(
+				it + 1,
+				commands.end(),
+				[&it](const queued_message& m) {
+					return m.message.type == json_message::ChangeState && m.message.payload["id"] == it->message.payload["id"];
+				}
+			);
+
+			if (!superseded) {
+				// the command was already accepted, so it's replayed regardless of it's deadline
+				queued_message replayed = *it;
+				replayed.priority = Urgent;
+				replayed.deadline.reset();
+				replayed.on_expired = nullptr;
+				// the outage isn't part of the round trip, it's measured from the replay
+				replayed.queued_time = clock::now();
+				resync_queue.push_back(std::move(replayed));
+			}
+		}
+
+		// and the state is queried last, after the replayed commands changed it
+		resync_queue.push_back({ json_message(json_message::QueryState, gate_ids), clock::now(), Urgent, "", std::nullopt, nullptr });
+
+		in_flight_commands.clear();
+		telemetry.record_outgoing_depth(outgoing_depth());
+	}
+
+	push_incoming(json_message(json_message::Availability, { { "available", true } }));
+
+	do_read();
+	if (!is_writing) {
+		do_write();
+	}
+}
+
+void arduino_messenger::do_read() {
+	com.async_read_some(
 		beast::bind_front_handler(
 			&arduino_messenger::on_read,
 			shared_from_this()
@@ -51,12 +174,14 @@ void arduino_messenger::on_read(
 	const boost::system::error_code& ec,
 	std::size_t bytes_transferred
 ) {
-	// this doesn't work
-	if (ec && !com.is_open()) {
-		std::cout << "COM-port closed." << std::endl;
+	// the port was closed because the link was lost
+	if (ec == net::error::operation_aborted) {
+		return;
 	}
 
+	// a read error or an end of file means the device is gone
 	if (ec) {
+		on_link_lost(ec);
 		return;
 	}
 
@@ -65,65 +190,338 @@ void arduino_messenger::on_read(
 		return;
 	}
 
-	buffer.commit(bytes_transferred);
+	const auto now = clock::now();
+	telemetry.record_received(bytes_transferred);
+
+	// the bytes of an incomplete message arrive one after another on the wire,
+	// so the gap between the reads shows how long the driver held them
+	if (partial_read_time) {
+		telemetry.record_byte_latency((now - partial_read_time.value()) / bytes_transferred);
+	}
+
+	frame_reader.append(com.received_data(bytes_transferred));
+
+	while (auto frame = frame_reader.next_frame()) {
+		try {
+			json_message jmsg = json_message::parse_message(frame.value());
+
+			if (jmsg.type == json_message::Error) {
+				std::cerr << "The device on " << com.get_device_name() << " reported an error: " << jmsg.payload << std::endl;
+			}
+
+			acknowledge(jmsg);
+
+			// the gates that finished moving are reported apart from the answers,
+			// but the rest of the server handles them like the results of a query
+			if (jmsg.type == json_message::Finished) {
+				jmsg.type = json_message::QueryStateResult;
+			}
+
+			push_incoming(jmsg);
+		}
+		catch (...) {
+			telemetry.record_parse_failure();
+		}
+	}
+
+	for (std::size_t i = frame_reader.take_dropped_count(); i > 0; i--) {
+		telemetry.record_dropped_frame();
+	}
+
+	if (frame_reader.has_partial_frame()) {
+		partial_read_time = now;
+	}
+	else {
+		partial_read_time.reset();
+	}
+
+	do_read();
+}
+
+bool arduino_messenger::is_answer(const json_message& command, const json_message& message) {
+	if (message.type != json_message::QueryStateResult || !message.payload.is_array()) {
+		return false;
+	}
+
+	const nlohmann::json& gates = message.payload;
+
+	// the device answers with an empty result only to a query of unknown gates
+	if (gates.empty()) {
+		return command.type == json_message::QueryState;
+	}
+
+	// a change_state is answered with the gate that started moving
+	if (command.type == json_message::ChangeState) {
+		const std::string state = gates[0].is_object() ? gates[0].value("state", "") : "";
+
+		return
+			gates.size() == 1 &&
+			gates[0].is_object() &&
+			gates[0].value("id", nlohmann::json()) == command.payload["id"] &&
+			(state == "raising" || state == "lowering");
+	}
+
+	// a batch is answered with all of it's gates, which started moving
+	if (command.type == json_message::ChangeStateBatch) {
+		nlohmann::json ids = command.payload.value("raise", nlohmann::json::array());
+		for (const auto& id : command.payload.value("lower", nlohmann::json::array())) {
+			ids.push_back(id);
+		}
+
+		return
+			gates.size() == ids.size() &&
+			std::all_of(
+				gates.begin(),
+				gates.end(),
+				[&ids](const nlohmann::json& gate) {
+					const std::string state = gate.is_object() ? gate.value("state", "") : "";
+
+					return
+						(state == "raising" || state == "lowering") &&
+						std::find(ids.begin(), ids.end(), gate.value("id", nlohmann::json())) != ids.end();
+				}
+			);
+	}
+
+	// a query_state is answered with all the queried gates
+	if (command.type == json_message::QueryState) {
+		const nlohmann::json& ids = command.payload;
+
+		return
+			gates.size() == ids.size() &&
+			std::all_of(
+				gates.begin(),
+				gates.end(),
+				[&ids](const nlohmann::json& gate) {
+					return
+						gate.is_object() &&
+						std::find(ids.begin(), ids.end(), gate.value("id", nlohmann::json())) != ids.end();
+				}
+			);
+	}
+
+	return false;
+}
+
+bool arduino_messenger::is_error_answer(const json_message& command, const json_message& error) {
+	if (!error.payload.is_string()) {
+		return false;
+	}
+
+	// the errors the device reports about a command of the type,
+	// the others are about a config, which isn't answered when it's applied, or about no command at all
+	const std::string reason = error.payload;
+
+	switch (command.type) {
+	case json_message::ChangeState:
+		return reason == "malformed_change_state_payload" || reason == "unknown_gate";
+	case json_message::ChangeStateBatch:
+		return reason == "malformed_change_state_batch_payload" || reason == "unknown_gate" || reason == "too_many_gates";
+	case json_message::QueryState:
+		return reason == "malformed_query_state_payload";
+	default:
+		return false;
+	}
+}
+
+void arduino_messenger::acknowledge(const json_message& message) {
+	// an error can only answer the oldest command, the device reports it instead of the command's result,
+	// an error that isn't about it answers nothing and takes no command along with it
+	if (message.type == json_message::Error) {
+		telemetry.record_device_error();
 
-	std::string message(
-		reinterpret_cast<const char*>(buffer.data().data()), 
-		buffer.data().size()
+		if (!in_flight_commands.empty() && is_error_answer(in_flight_commands.front().message, message)) {
+			const queued_message& answered = in_flight_commands.front();
+			telemetry.record_ack(answered.message.type, answered.priority, clock::now() - answered.queued_time);
+			in_flight_commands.pop_front();
+		}
+		return;
+	}
+
+	// the device answers the commands in the order they were sent,
+	// the gates that finished moving on their own are reported with a type of their own, which answers nothing
+	const auto answered = std::find_if(
+		in_flight_commands.begin(),
+		in_flight_commands.end(),
+		[&message](const queued_message& command) { return is_answer(command.message, message); }
 	);
 
-	buffer.consume(bytes_transferred);
+	if (answered == in_flight_commands.end()) {
+		return;
+	}
+
+	telemetry.record_ack(answered->message.type, answered->priority, clock::now() - answered->queued_time);
 
+	// the commands sent before the answered one were lost on the way
+	for (auto it = in_flight_commands.begin(); it != answered; it++) {
+		telemetry.record_unanswered_command();
+	}
+
+	in_flight_commands.erase(in_flight_commands.begin(), answered + 1);
+}
+
+void arduino_messenger::push_incoming(json_message message) {
 	std::lock_guard lock(imq_mutex);
-	try {
-		json_message jmsg = json_message::parse_message(message);
-		incoming_message_queue.push(jmsg);
+	incoming_message_queue.push(message);
+	telemetry.record_incoming_depth(incoming_message_queue.size());
+
+	if (on_message) {
+		on_message();
 	}
-	catch (...) {}
+}
 
-	do_read();
+std::optional<std::size_t> arduino_messenger::select_lane() {
+	std::optional<std::size_t> selected;
+
+	for (std::size_t lane = 0; lane < MESSAGE_PRIORITY_COUNT; lane++) {
+		if (outgoing_lanes[lane].empty()) {
+			skipped_writes[lane] = 0;
+			continue;
+		}
+
+		if (!selected) {
+			selected = lane;
+		}
+		// a lower lane that was passed over too many times goes first, so it isn't starved
+		else if (skipped_writes[lane] >= MAX_SKIPPED_WRITES) {
+			selected = lane;
+			break;
+		}
+	}
+
+	if (!selected) {
+		return std::nullopt;
+	}
+
+	// every other non-empty lane was passed over
+	for (std::size_t lane = 0; lane < MESSAGE_PRIORITY_COUNT; lane++) {
+		if (lane == selected.value()) {
+			skipped_writes[lane] = 0;
+		}
+		else if (!outgoing_lanes[lane].empty()) {
+			skipped_writes[lane]++;
+		}
+	}
+
+	return selected;
+}
+
+std::size_t arduino_messenger::get_outgoing_depth() {
+	std::lock_guard lock(omq_mutex);
+	return outgoing_depth();
+}
+
+std::size_t arduino_messenger::outgoing_depth() const {
+	std::size_t depth = resync_queue.size();
+	for (const auto& lane : outgoing_lanes) {
+		depth += lane.size();
+	}
+	return depth;
+}
+
+std::size_t arduino_messenger::outgoing_depth(const std::string& owner) const {
+	std::size_t depth = 0;
+	for (const auto& lane : outgoing_lanes) {
+		depth += lane.size(owner);
+	}
+	return depth;
 }
 
 void arduino_messenger::do_write() {
-	if (!outgoing_message_queue.empty()) {
-		outgoing_message_buffer = outgoing_message_queue.front().dump_message();
-		outgoing_message_queue.pop();
-
-		net::async_write(
-			com,
-			net::buffer(outgoing_message_buffer),
-			beast::bind_front_handler(
-				&arduino_messenger::on_write,
-				shared_from_this()
-			)
-		);
+	// messages wait in the queue until the link is restored
+	if (!is_available) {
+		is_writing = false;
+		return;
 	}
-	else {
-		net::post(
-			com.get_executor(),
-			std::bind(
-				&arduino_messenger::do_write,
-				shared_from_this()
-			)
-		);
+
+	// the commands that missed their deadline, reported after the queues are unlocked
+	std::vector<queued_message> expired;
+	bool has_message = false;
+
+	{
+		std::lock_guard lock(omq_mutex);
+
+		const auto now = clock::now();
+
+		// drop the stale commands instead of spending the link on them,
+		// they aren't writes, so the lanes' skip counters stay as they are
+		for (auto& queue : outgoing_lanes) {
+			while (!queue.empty() && queue.front().deadline && queue.front().deadline.value() < now) {
+				telemetry.record_expired_command();
+				expired.push_back(std::move(queue.front()));
+				queue.pop_front();
+			}
+		}
+
+		// the resync messages go before anything queued in the lanes
+		std::optional<std::size_t> lane;
+		if (resync_queue.empty()) {
+			lane = select_lane();
+		}
+
+		// the write loop stops when the queues are empty,
+		// send_message restarts it when a new message arrives
+		if (!resync_queue.empty() || lane) {
+			const queued_message& queued = lane ? outgoing_lanes[lane.value()].front() : resync_queue.front();
+			telemetry.record_write(queued.message.type, queued.priority, now - queued.queued_time);
+
+			// only the commands the device answers to are tracked
+			if (
+				queued.message.type == json_message::ChangeState ||
+				queued.message.type == json_message::ChangeStateBatch ||
+				queued.message.type == json_message::QueryState
+			) {
+				in_flight_commands.push_back(queued);
+			}
+
+			outgoing_message_buffer = queued.message.dump_message();
+			if (lane) {
+				outgoing_lanes[lane.value()].pop_front();
+			}
+			else {
+				resync_queue.pop_front();
+			}
+			has_message = true;
+		}
+
+		telemetry.record_outgoing_depth(outgoing_depth());
 	}
+
+	for (const queued_message& command : expired) {
+		if (command.on_expired) {
+			command.on_expired(command.message);
+		}
+	}
+
+	if (!has_message) {
+		is_writing = false;
+		return;
+	}
+
+	is_writing = true;
+
+	com.async_write(
+		net::buffer(outgoing_message_buffer),
+		beast::bind_front_handler(
+			&arduino_messenger::on_write,
+			shared_from_this()
+		)
+	);
 }
 
 void arduino_messenger::on_write(
 	const boost::system::error_code& ec,
 	std::size_t bytes_transferred
 ) {
-	boost::ignore_unused(bytes_transferred);
+	telemetry.record_sent(bytes_transferred);
 
 	outgoing_message_buffer.clear();
 
 	if (ec) {
-		// this doesn't work, else-clause called
-		if (!com.is_open()) {
-			std::cerr << "COM-port closed." << std::endl;
-		}
-		else {
-			std::cerr << "Couldn't write to COM-port: " << ec.message() << std::endl;
+		is_writing = false;
+
+		if (ec != net::error::operation_aborted) {
+			on_link_lost(ec);
 		}
 		return;
 	}
@@ -131,7 +529,90 @@ void arduino_messenger::on_write(
 	do_write();
 }
 
-void arduino_messenger::send_message(json_message message) {
-	std::lock_guard lock(omq_mutex);
-	outgoing_message_queue.push(message);
+bool arduino_messenger::send_message(
+	json_message message,
+	MessagePriority priority,
+	const std::string& owner,
+	std::optional<clock::time_point> deadline,
+	expired_handler on_expired
+) {
+	{
+		std::lock_guard lock(omq_mutex);
+
+		// an owner with nothing queued still gets it's turn,
+		// so only the ones flooding the link are turned away
+		if (!owner.empty() && outgoing_depth() >= MAX_BACKLOG && outgoing_depth(owner) > 0) {
+			telemetry.record_busy_rejection();
+			return false;
+		}
+
+		outgoing_lanes[priority].push_back(
+			owner,
+			{ message, clock::now(), priority, owner, deadline, std::move(on_expired) }
+		);
+		telemetry.record_outgoing_depth(outgoing_depth());
+	}
+
+	// start the write loop on the port's strand if it's idle
+	net::post(
+		com.get_executor(),
+		[self = shared_from_this()] {
+			if (!self->is_writing) {
+				self->do_write();
+			}
+		}
+	);
+
+	return true;
+}
+
+void arduino_messenger::set_gate_ids(std::vector<unsigned int> ids) {
+	net::post(
+		com.get_executor(),
+		[self = shared_from_this(), ids = std::move(ids)] {
+			self->gate_ids = ids;
+		}
+	);
+}
+
+void arduino_messenger::set_device_config(nlohmann::json config) {
+	net::post(
+		com.get_executor(),
+		[self = shared_from_this(), config = std::move(config)] {
+			self->device_config = config;
+
+			{
+				std::lock_guard lock(self->omq_mutex);
+				self->resync_queue.push_back({ json_message(json_message::Config, config), clock::now(), Urgent, "", std::nullopt, nullptr });
+				self->telemetry.record_outgoing_depth(self->outgoing_depth());
+			}
+
+			if (!self->is_writing) {
+				self->do_write();
+			}
+		}
+	);
+}
+
+void arduino_messenger::set_message_handler(message_handler handler) {
+	std::lock_guard lock(imq_mutex);
+	on_message = std::move(handler);
+}
+
+std::optional<json_message> arduino_messenger::pop_message() {
+	std::lock_guard lock(imq_mutex);
+
+	if (incoming_message_queue.empty()) {
+		return std::nullopt;
+	}
+
+	json_message message = incoming_message_queue.front();
+	incoming_message_queue.pop();
+	telemetry.record_incoming_depth(incoming_message_queue.size());
+
+	return message;
+}
+
+link_telemetry::snapshot arduino_messenger::get_telemetry() {
+	return telemetry.take_snapshot();
 }
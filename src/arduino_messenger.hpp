@@ -4,36 +4,104 @@
 #include "common.hpp"
 
 #include <queue>
+#include <deque>
 #include <thread>
+#include <optional>
+#include <chrono>
+#include <array>
+#include <functional>
 
-#include <boost/asio/serial_port.hpp>
-#include <boost/asio/streambuf.hpp>
 #include <boost/asio/error.hpp>
 #include <boost/asio/placeholders.hpp>
 #include <boost/asio/read_until.hpp>
 #include <boost/asio/read.hpp>
 #include <boost/asio/write.hpp>
 #include <boost/asio/post.hpp>
+#include <boost/asio/strand.hpp>
+#include <boost/asio/steady_timer.hpp>
 
 #include <boost/beast/core/bind_handler.hpp>
 
 #include "json_message.hpp"
+#include "link_telemetry.hpp"
+#include "serial_transport.hpp"
+#include "json_frame_reader.hpp"
+#include "config.hpp"
+#include "message_priority.hpp"
+#include "fair_queue.hpp"
 
 class arduino_messenger : public std::enable_shared_from_this<arduino_messenger> {
+public:
+	using clock = std::chrono::steady_clock;
+	// called with a command that was dropped for missing it's deadline
+	using expired_handler = std::function<void(const json_message&)>;
+	// called when a received message is queued, with the incoming queue locked
+	using message_handler = std::function<void()>;
+
+private:
 	static constexpr std::size_t MAX_MESSAGE_LENGTH = 10240;
 
-	net::serial_port com;
-	net::streambuf buffer;
+	// reconnection attempts start with the initial delay and double until the maximum one
+	static constexpr std::chrono::milliseconds INITIAL_RECONNECT_DELAY{ 250 };
+	static constexpr std::chrono::milliseconds MAX_RECONNECT_DELAY{ 10000 };
+
+	serial_transport com;
+	json_frame_reader frame_reader{ MAX_MESSAGE_LENGTH };
+	// when the last read completed while a message was still incomplete
+	std::optional<clock::time_point> partial_read_time;
+
+	// a lower lane gets a write after this many writes from the higher lanes passed it over
+	static constexpr unsigned int MAX_SKIPPED_WRITES = 8;
+	// above this many queued messages, the owners who already have some queued are turned away
+	static constexpr std::size_t MAX_BACKLOG = 64;
+
+	struct queued_message {
+		json_message message;
+		clock::time_point queued_time;
+		MessagePriority priority;
+		// the user the message was sent for, empty for the server's own messages
+		std::string owner;
+		// the command isn't worth sending after this
+		std::optional<clock::time_point> deadline;
+		expired_handler on_expired;
+	};
 
-	std::queue<json_message> outgoing_message_queue;
+	// one queue per priority, the higher lanes are written first,
+	// and the messages of a lane are taken from it's owners round-robin
+	std::array<fair_queue<queued_message>, MESSAGE_PRIORITY_COUNT> outgoing_lanes;
+	// how many writes passed over the non-empty lane
+	std::array<unsigned int, MESSAGE_PRIORITY_COUNT> skipped_writes{};
+	// the config, the replayed commands and the state query that resync the device,
+	// written in order before anything from the lanes
+	std::deque<queued_message> resync_queue;
 	std::mutex omq_mutex;
 
 	std::string outgoing_message_buffer;
 
-public:
+	// only accessed from the port's strand
+	bool is_writing = false;
+	bool is_available = true;
+	net::steady_timer reconnect_timer;
+	std::chrono::milliseconds reconnect_delay = INITIAL_RECONNECT_DELAY;
+	clock::time_point link_lost_time;
+
+	// commands written to the port which the device hasn't reported back on yet, in order,
+	// the change_state ones are replayed after a reconnect
+	std::deque<queued_message> in_flight_commands;
+
+	// the gates to query after a reconnect to resync the state
+	std::vector<unsigned int> gate_ids;
+	// the settings sent to the device before anything else on every connect
+	std::optional<nlohmann::json> device_config;
+
 	std::queue<json_message> incoming_message_queue;
 	std::mutex imq_mutex;
+	// guarded by imq_mutex
+	message_handler on_message;
 
+	link_telemetry telemetry;
+
+public:
 	class open_error : public std::runtime_error {
 	public:
 		open_error(const char* what) : std::runtime_error(what) {}
@@ -42,14 +110,58 @@ public:
 	arduino_messenger(
 		net::io_context& io,
 		std::string_view device_name,
-		unsigned int baud_rate = 9600
+		serial_options options = serial_options()
 	);
 
-	void send_message(json_message message);
+	// returns false if the message was turned away, because the link is busy
+	// and the owner already has messages waiting,
+	// a message still queued at it's deadline is dropped and passed to on_expired
+	bool send_message(
+		json_message message,
+		MessagePriority priority = Routine,
+		const std::string& owner = "",
+		std::optional<clock::time_point> deadline = std::nullopt,
+		expired_handler on_expired = nullptr
+	);
+
+	// sets the (local) gate ids to query after the link is restored
+	void set_gate_ids(std::vector<unsigned int> ids);
+
+	// sets the config message payload to send ahead of everything else,
+	// now and after the link is restored
+	void set_device_config(nlohmann::json config);
+
+	// sets the function to call whenever a received message is queued, so the messages don't have to be polled,
+	// it must not call back into the messenger
+	void set_message_handler(message_handler handler);
+
+	// takes the oldest received message, if there is one
+	std::optional<json_message> pop_message();
+
+	// the link's counters, with the rates and queue peaks since the previous call
+	link_telemetry::snapshot get_telemetry();
+
+	// how many messages wait to be written
+	std::size_t get_outgoing_depth();
 
 	void run();
 
 private:
+	void open_port(boost::system::error_code& error);
+
+	void on_link_lost(const boost::system::error_code& ec);
+	void do_reconnect();
+	void on_reconnect_timer(const boost::system::error_code& ec);
+	static bool is_answer(const json_message& command, const json_message& message);
+	static bool is_error_answer(const json_message& command, const json_message& error);
+	void acknowledge(const json_message& message);
+	void push_incoming(json_message message);
+
+	// the lane to write from next, expects omq_mutex to be locked
+	std::optional<std::size_t> select_lane();
+	std::size_t outgoing_depth() const;
+	std::size_t outgoing_depth(const std::string& owner) const;
+
 	void do_read();
 	void do_write();
 	void on_read(const boost::system::error_code& ec, std::size_t bytes_transferred);
@@ -0,0 +1,135 @@
+#ifndef FRAME_READER_H
+#define FRAME_READER_H
+
+#include <stddef.h>
+
+// accumulates received bytes in a fixed ring buffer and splits them into JSON documents,
+// independent of the Arduino APIs so that it can be shared with the simulator
+class FrameReader {
+public:
+  static const unsigned int BUFFER_SIZE = 256;
+
+private:
+  // complete frames are stored one after another, each terminated by a '\0'
+  char ring[BUFFER_SIZE];
+  unsigned int head = 0;
+  unsigned int tail = 0;
+  unsigned int used = 0;
+  unsigned int complete_frames = 0;
+
+  // the scanning state of the frame being received
+  bool in_frame = false;
+  bool discarding = false;
+  bool in_string = false;
+  bool escaped = false;
+  int depth = 0;
+  unsigned int frame_start = 0;
+  unsigned int frame_used = 0;
+
+  bool overflowed = false;
+
+  void store(char c) {
+    ring[head] = c;
+    head = (head + 1) % BUFFER_SIZE;
+    used++;
+  }
+
+public:
+  // adds a received byte
+  void push(char c) {
+    // skip everything between the documents
+    if (!in_frame) {
+      if (c != '{' && c != '[') {
+        return;
+      }
+
+      in_frame = true;
+      in_string = false;
+      escaped = false;
+      discarding = false;
+      depth = 0;
+      frame_start = head;
+      frame_used = used;
+    }
+
+    // the terminator has to fit as well, drop the frame if the buffer is full
+    // but keep scanning it to find where it ends
+    if (!discarding && used + 2 > BUFFER_SIZE) {
+      head = frame_start;
+      used = frame_used;
+      discarding = true;
+      overflowed = true;
+    }
+
+    if (!discarding) {
+      store(c);
+    }
+
+    if (in_string) {
+      if (escaped)          escaped = false;
+      else if (c == '\\')   escaped = true;
+      else if (c == '"')    in_string = false;
+    }
+    else if (c == '"')              in_string = true;
+    else if (c == '{' || c == '[')  depth++;
+    else if (c == '}' || c == ']')  depth--;
+
+    if (depth == 0) {
+      in_frame = false;
+
+      if (!discarding) {
+        store('\0');
+        complete_frames++;
+      }
+    }
+  }
+
+  bool has_frame() const {
+    return complete_frames > 0;
+  }
+
+  // reads the next byte of the oldest complete frame, -1 at its end
+  // (the read()/readBytes() pair makes this a reader for deserializeJson)
+  int read() {
+    if (complete_frames == 0 || ring[tail] == '\0') {
+      return -1;
+    }
+
+    const char c = ring[tail];
+    tail = (tail + 1) % BUFFER_SIZE;
+    used--;
+    return static_cast<unsigned char>(c);
+  }
+
+  size_t readBytes(char* buffer, size_t length) {
+    size_t count = 0;
+    int c;
+    while (count < length && (c = read()) >= 0) {
+      buffer[count++] = static_cast<char>(c);
+    }
+    return count;
+  }
+
+  // discards what's left of the oldest complete frame
+  void finish_frame() {
+    if (complete_frames == 0) {
+      return;
+    }
+
+    while (read() >= 0) {}
+
+    // the terminator
+    tail = (tail + 1) % BUFFER_SIZE;
+    used--;
+    complete_frames--;
+  }
+
+  // returns true once after a frame was dropped for not fitting in the buffer
+  bool take_overflow() {
+    const bool result = overflowed;
+    overflowed = false;
+    return result;
+  }
+};
+
+#endif
@@ -0,0 +1,90 @@
+#ifndef GATE_H
+#define GATE_H
+
+// the gate logic, independent of the Arduino APIs so that it can be shared with the simulator
+
+enum GateState {
+  Raised, Raising,
+  Lowered, Lowering
+};
+
+class Gate {
+  // the time a full raise or lower takes
+  static const unsigned long TRAVEL_TIME = 1000;
+
+  bool just_finished = false;
+  bool is_lowering = false;
+  bool is_changing = false;
+
+  // the millis() value the state was last advanced at
+  unsigned long last_update = 0;
+
+public:
+  float state = 0.0F;
+
+  // advances the state by the time passed since the last tick,
+  // returns true if state changed
+  bool tick(unsigned long now) {
+    if (just_finished) {
+      just_finished = false;
+    }
+    if (!is_changing) {
+      return false;
+    }
+
+    // unsigned subtraction stays correct when millis() overflows
+    const unsigned long elapsed = now - last_update;
+    if (elapsed == 0) {
+      return false;
+    }
+    last_update = now;
+
+    const float step = static_cast<float>(elapsed) / TRAVEL_TIME;
+    if (is_lowering) {
+      state -= step;
+    } else {
+      state += step;
+    }
+
+    if (state <= 0.0F || state >= 1.0F) {
+      is_changing = false;
+      just_finished = true;
+
+      if (state < 0.0F) {
+        state = 0.0F;
+      } else if (state > 1.0F) {
+        state = 1.0F;
+      }
+    }
+
+    return true;
+  }
+
+  bool finished_moving() const {
+    return just_finished;
+  }
+
+  void lower(unsigned long now) {
+    is_lowering = true;
+    is_changing = true;
+    last_update = now;
+  }
+
+  void raise(unsigned long now) {
+    is_lowering = false;
+    is_changing = true;
+    last_update = now;
+  }
+
+  GateState get_state() const {
+    if (is_changing) {
+      if (is_lowering)  return Lowering;
+      else              return Raising;
+    }
+
+    if (state >= 1.0F)  return Raised;
+    else                return Lowered;
+  }
+};
+
+#endif
@@ -2,12 +2,19 @@
 #include <string.h>
 #include <math.h>
 
+#include "gate.h"
+#include "frame_reader.h"
+
 const char* TYPE = "type";
 const char* PAYLOAD = "payload";
 const char* CHANGE_STATE = "change_state";
+const char* CHANGE_STATE_BATCH = "change_state_batch";
 const char* QUERY_STATE = "query_state";
 const char* QUERY_STATE_RESULT = "query_state_result";
+// the gates that finished moving on their own, which isn't an answer to a command
+const char* FINISHED = "finished";
 const char* CONFIG = "config";
+const char* PROGRESS = "progress";
 
 const char* ERROR_MESSAGE_START = "{\"type\": \"error\", \"payload\": \"";
 const char* ERROR_MESSAGE_END = "\"}";
@@ -18,95 +25,39 @@ const char* STATE_LOWERED = "lowered";
 const char* STATE_LOWERING = "lowering";
 
 const unsigned int LED_PIN = 13;
-const unsigned int GATE_DELAY = 10;
-
-const unsigned int GATE_PINS[] = { 3, 5, 6, 9, 10, 11, 13 };
-const unsigned int GATE_PINS_SIZE = 7;
-
-JsonDocument doc;
-
-enum GateState {
-  Raised, Raising,
-  Lowered, Lowering
-};
-
-class Gate {
-  static const unsigned int CHANGE_DELAY = 10;
-  
-  bool just_finished = false;
-  bool is_lowering = false;
-  bool is_changing = false;
-
-public:
-  float state = 0.0F;
-
-  // returns true if state changed
-  bool tick() {
-    if (just_finished) {
-      just_finished = false;
-    }
-    if (!is_changing) {
-      return false;
-    }
-
-    if (is_lowering) {
-      state -= 0.01F;
-    } else {
-      state += 0.01F;
-    }
-
-    delay(CHANGE_DELAY);
 
-    if (state <= 0.0F || state >= 1.0F) {
-      is_changing = false;
-      just_finished = true;
+// the pins used until the server sends a config message with it's own pin table
+const unsigned char DEFAULT_GATE_PINS[] = { 3, 5, 6, 9, 10, 11, 13 };
+const unsigned int DEFAULT_GATE_PINS_SIZE = 7;
 
-      if (state < 0.0F) {
-        state = 0.0F;
-      } else if (state > 1.0F) {
-        state = 1.0F;
-      }
-    }
-
-    return true;
-  }
+const unsigned int MAX_GATES = 32;
 
-  bool finished_moving() const {
-    return just_finished;
-  }
+// the shortest interval between progress messages, which caps their rate
+const unsigned long MIN_PROGRESS_INTERVAL = 20;
 
-  void lower() {
-    is_lowering = true;
-    is_changing = true;
-  }
+JsonDocument doc;
+FrameReader reader;
 
-  void raise() {
-    is_lowering = false;
-    is_changing = true;
-  }
+unsigned char gate_pins[MAX_GATES];
+unsigned int gate_count = 0;
 
-  GateState get_state() const {
-    if (!is_changing) {
-      if (state == 1.0F) return Raised;
-      if (state == 0.0F) return Lowered;
-    } else {
-      if (is_lowering)  return Lowering;
-      else              return Raising;
-    }
-  }
-};
+Gate gates[MAX_GATES];
+// the last PWM value written to each gate's pin
+unsigned char gate_pwm[MAX_GATES];
 
-Gate gates[GATE_PINS_SIZE];
+// how often the positions of moving gates are reported, 0 disables the reports
+unsigned long progress_interval = 0;
+unsigned long last_progress = 0;
 
-void send_gate_states(unsigned int* ids, unsigned int ids_count) {
+void send_gate_states(unsigned int* ids, unsigned int ids_count, const char* type) {
   JsonDocument dyn_doc;
-  dyn_doc[TYPE] = QUERY_STATE_RESULT;
+  dyn_doc[TYPE] = type;
 
   JsonArray payload_arr = dyn_doc[PAYLOAD].to<JsonArray>();
 
   for (int i = 0; i < ids_count; i++) {
     unsigned int& id = ids[i];
-    if (id >= GATE_PINS_SIZE) {
+    if (id >= gate_count) {
       continue;
     }
 
@@ -137,7 +88,7 @@ void send_gate_states(JsonArray ids) {
       continue;
     }
     unsigned int id = el.as<unsigned int>();
-    if (id >= GATE_PINS_SIZE) {
+    if (id >= gate_count) {
       continue;
     }
 
@@ -159,30 +110,62 @@ void send_gate_states(JsonArray ids) {
 
 void send_gate_state(unsigned int id) {
   unsigned int arr[1] = { id };
-  send_gate_states(arr, 1);
+  send_gate_states(arr, 1, QUERY_STATE_RESULT);
 }
 
-unsigned int index_to_pin(unsigned int id) {
-  if (id >= GATE_PINS_SIZE) {
-    return GATE_PINS_SIZE + 1;
+// reports the position of every moving gate in percent
+void send_progress(unsigned long now) {
+  if (progress_interval == 0 || now - last_progress < progress_interval) {
+    return;
   }
-  return GATE_PINS[id];
+
+  JsonDocument dyn_doc;
+  dyn_doc[TYPE] = PROGRESS;
+
+  JsonArray payload_arr = dyn_doc[PAYLOAD].to<JsonArray>();
+
+  for (unsigned int i = 0; i < gate_count; i++) {
+    GateState state = gates[i].get_state();
+    if (state != Raising && state != Lowering) {
+      continue;
+    }
+
+    JsonObject obj = payload_arr.add<JsonObject>();
+
+    obj["id"] = i;
+    obj["position"] = static_cast<unsigned int>(gates[i].state * 100 + 0.5F);
+  }
+
+  if (payload_arr.size() == 0) {
+    return;
+  }
+
+  serializeJson(dyn_doc, Serial);
+  last_progress = now;
 }
 
 void send_error(const char* payload = "unknown") {
-  int new_str_size = strlen(ERROR_MESSAGE_START) + strlen(payload) + strlen(ERROR_MESSAGE_END);
-  char* new_str = new char[new_str_size];
-  for (int i = 0; i < new_str_size; i++) {
-    new_str[i] = '\0';
-  }
+  Serial.print(ERROR_MESSAGE_START);
+  Serial.print(payload);
+  Serial.print(ERROR_MESSAGE_END);
+}
+
+// assigns the pins to the gates, the gates which keep their pin also keep their state
+void set_gate_pins(const unsigned char* pins, unsigned int count) {
+  for (unsigned int i = 0; i < count; i++) {
+    if (i < gate_count && gate_pins[i] == pins[i]) {
+      continue;
+    }
 
-  strcat(new_str, ERROR_MESSAGE_START);
-  strcat(new_str, payload);
-  strcat(new_str, ERROR_MESSAGE_END);
+    gate_pins[i] = pins[i];
+    gates[i] = Gate();
+    gate_pwm[i] = 0;
 
-  Serial.write(new_str);
+    pinMode(gate_pins[i], OUTPUT);
+    analogWrite(gate_pins[i], 0);
+  }
 
-  delete[] new_str;
+  gate_count = count;
 }
 
 void handle_message() {
@@ -212,15 +195,70 @@ void handle_message() {
     unsigned int id = msg_data["id"].as<unsigned int>();
     bool new_state = msg_data["state"].as<bool>();
 
+    if (id >= gate_count) {
+      send_error("unknown_gate");
+      return;
+    }
+
     Gate& selected_gate = gates[id];
 
     if (new_state) {
-      selected_gate.raise();
+      selected_gate.raise(millis());
       send_gate_state(id);
     } else {
-      selected_gate.lower();
+      selected_gate.lower(millis());
       send_gate_state(id);
     }
+  } else if (strcmp(type, CHANGE_STATE_BATCH) == 0) {
+    if (!doc[PAYLOAD].is<JsonObject>()) {
+      send_error("malformed_change_state_batch_payload");
+      return;
+    }
+    JsonVariant raise_ids = doc[PAYLOAD]["raise"];
+    JsonVariant lower_ids = doc[PAYLOAD]["lower"];
+
+    // check the whole batch first, so that it's either applied entirely or not at all
+    unsigned int ids[MAX_GATES];
+    unsigned int count = 0;
+    JsonVariant lists[2] = { raise_ids, lower_ids };
+    for (int l = 0; l < 2; l++) {
+      if (lists[l].isNull()) {
+        continue;
+      }
+      if (!lists[l].is<JsonArray>()) {
+        send_error("malformed_change_state_batch_payload");
+        return;
+      }
+
+      for (JsonVariant el : lists[l].as<JsonArray>()) {
+        if (!el.is<unsigned int>()) {
+          send_error("malformed_change_state_batch_payload");
+          return;
+        }
+        if (el.as<unsigned int>() >= gate_count) {
+          send_error("unknown_gate");
+          return;
+        }
+        if (count >= MAX_GATES) {
+          send_error("too_many_gates");
+          return;
+        }
+        ids[count++] = el.as<unsigned int>();
+      }
+    }
+
+    // all the gates start moving at the same time
+    unsigned long now = millis();
+    unsigned int raise_count = raise_ids.is<JsonArray>() ? raise_ids.size() : 0;
+    for (unsigned int i = 0; i < count; i++) {
+      if (i < raise_count) {
+        gates[ids[i]].raise(now);
+      } else {
+        gates[ids[i]].lower(now);
+      }
+    }
+
+    send_gate_states(ids, count, QUERY_STATE_RESULT);
   } else if (strcmp(type, QUERY_STATE) == 0) {
     if (!doc[PAYLOAD].is<JsonArray>()) {
       send_error("malformed_query_state_payload");
@@ -229,44 +267,108 @@ void handle_message() {
     JsonArray query = doc[PAYLOAD].as<JsonArray>();
 
     send_gate_states(query);
+  } else if (strcmp(type, CONFIG) == 0) {
+    if (!doc[PAYLOAD].is<JsonObject>()) {
+      send_error("malformed_config_payload");
+      return;
+    }
+    JsonObject config = doc[PAYLOAD].as<JsonObject>();
+
+    // every setting is optional
+    if (!config["progressInterval"].isNull()) {
+      if (!config["progressInterval"].is<unsigned long>()) {
+        send_error("malformed_config_payload");
+        return;
+      }
+
+      progress_interval = config["progressInterval"].as<unsigned long>();
+      if (progress_interval != 0 && progress_interval < MIN_PROGRESS_INTERVAL) {
+        progress_interval = MIN_PROGRESS_INTERVAL;
+      }
+    }
+
+    if (!config["pins"].isNull()) {
+      if (!config["pins"].is<JsonArray>()) {
+        send_error("malformed_config_payload");
+        return;
+      }
+      JsonArray pins_arr = config["pins"].as<JsonArray>();
+
+      if (pins_arr.size() > MAX_GATES) {
+        send_error("too_many_gates");
+        return;
+      }
+
+      unsigned char pins[MAX_GATES];
+      unsigned int count = 0;
+      for (JsonVariant el : pins_arr) {
+        if (!el.is<unsigned char>()) {
+          send_error("malformed_config_payload");
+          return;
+        }
+        pins[count++] = el.as<unsigned char>();
+      }
+
+      set_gate_pins(pins, count);
+    }
   } else {
     send_error();
   }
 }
 
-void update_gates() {
-  for (int i = 0; i < GATE_PINS_SIZE; i++) {
+void update_gates(unsigned long now) {
+  // the gates that finished moving together are reported together
+  unsigned int finished[MAX_GATES];
+  unsigned int finished_count = 0;
+
+  for (int i = 0; i < gate_count; i++) {
     Gate& gate = gates[i];
 
     // if the tick changed state
-    if (gate.tick()) {
-      // update physical LED state
-      unsigned int pin = GATE_PINS[i];
+    if (gate.tick(now)) {
+      // update physical LED state, the pin is only written when the value changes
       unsigned char value = static_cast<unsigned char>(floorf(powf(gate.state, 2) * 255));
-      analogWrite(pin, value);
+      if (value != gate_pwm[i]) {
+        analogWrite(gate_pins[i], value);
+        gate_pwm[i] = value;
+      }
     }
 
     if (gate.finished_moving()) {
-      send_gate_state(i);
+      finished[finished_count++] = i;
     }
   }
+
+  if (finished_count > 0) {
+    send_gate_states(finished, finished_count, FINISHED);
+  }
 }
 
 void setup() {
   Serial.begin(115200);
-  Serial.setTimeout(50);
 
   pinMode(LED_PIN, OUTPUT);
-  for (int i = 0; i < GATE_PINS_SIZE; i++) {
-    pinMode(GATE_PINS[i], OUTPUT);
-  }
+  set_gate_pins(DEFAULT_GATE_PINS, DEFAULT_GATE_PINS_SIZE);
 }
 
 void loop() {
-  if (Serial.available() > 0) {
-    deserializeJson(doc, Serial);
-    handle_message();
+  // take whatever arrived without waiting for the rest of a message,
+  // handling every message as soon as it's complete so that a burst doesn't fill the buffer
+  while (Serial.available() > 0) {
+    reader.push(static_cast<char>(Serial.read()));
+
+    if (reader.take_overflow()) {
+      send_error("message_too_long");
+    }
+
+    while (reader.has_frame()) {
+      deserializeJson(doc, reader);
+      reader.finish_frame();
+      handle_message();
+    }
   }
 
-  update_gates();
+  unsigned long now = millis();
+  update_gates(now);
+  send_progress(now);
 }
@@ -0,0 +1,44 @@
+#include "asset_cache.hpp"
+
+#include "gzip.hpp"
+#include "auth.hpp"
+#include "route_table.hpp"
+
+asset_cache::asset_cache() {
+    const auto embedded_assets = get_embedded_assets();
+    assets.reserve(embedded_assets.size());
+
+    for (const embedded_asset& embedded : embedded_assets) {
+        asset loaded;
+        loaded.body = embedded.body;
+        loaded.is_immutable = embedded.is_immutable;
+        loaded.content_type = mime_type(embedded.path);
+
+        // the variants are different representations, so they get different strong ETags
+        const std::string hash = sha256_hash(std::string(embedded.body));
+        loaded.etag = '"' + hash + '"';
+        loaded.gzip_etag = '"' + hash + "-gzip\"";
+
+        if (embedded.body.size() >= MIN_GZIP_SIZE) {
+            std::string compressed = gzip_compress(embedded.body, GZIP_LEVEL);
+            if (compressed.size() < embedded.body.size()) {
+                loaded.gzip_body = std::move(compressed);
+            }
+        }
+
+        assets.push_back(std::move(loaded));
+    }
+}
+
+const asset_cache::asset* asset_cache::get(std::string_view path) const {
+    const std::size_t index = find_embedded_asset(path);
+    if (index >= assets.size()) {
+        return nullptr;
+    }
+
+    return &assets[index];
+}
+
+std::size_t asset_cache::size() const {
+    return assets.size();
+}
@@ -0,0 +1,44 @@
+#ifndef ASSET_CACHE_HPP
+#define ASSET_CACHE_HPP
+
+#include <string>
+#include <string_view>
+#include <optional>
+#include <vector>
+
+#include "embedded_client.hpp"
+
+// the files of the client web app compiled into the server,
+// along with a gzip compressed variant and a strong ETag of each, made at startup,
+// the assets are never dropped, so they can be sent without copying
+class asset_cache {
+    // smaller files aren't worth compressing
+    static constexpr std::size_t MIN_GZIP_SIZE = 256;
+    static constexpr int GZIP_LEVEL = 9;
+
+public:
+    struct asset {
+        std::string_view body;
+        std::string etag;
+        // only kept if it's smaller than the body
+        std::optional<std::string> gzip_body;
+        std::string gzip_etag;
+        std::string_view content_type;
+        // whether the asset's path has the hash of it's content, so the browsers can keep it for good
+        bool is_immutable;
+    };
+
+private:
+    // in the order of get_embedded_assets()
+    std::vector<asset> assets;
+
+public:
+    asset_cache();
+
+    // the asset at the path, nullptr if there's no such file
+    const asset* get(std::string_view path) const;
+
+    std::size_t size() const;
+};
+
+#endif
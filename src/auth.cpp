@@ -1,28 +1,5 @@
 #include "auth.hpp"
 
-std::optional<AuthorizationType> get_endpoint_permissions(
-	std::string_view path
-) {
-    for (const auto& pair : endpoint_map) {
-        const std::string& endpoint = pair.first;
-        const auto& permissions = pair.second;
-
-        if (path.starts_with(endpoint)) {
-            if (path.size() > endpoint.size()) {
-                if (path.find("/", endpoint.size()) != std::string_view::npos) {
-					return get_endpoint_permissions(path.substr(0, path.rfind('/')));
-                }
-                else {
-                    return std::nullopt;
-                }
-            }
-            return permissions;
-        }
-    }
-
-    return std::nullopt;
-}
-
 void digest_auth::set_field(
     std::string_view key,
     std::string_view value
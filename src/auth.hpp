@@ -23,18 +23,6 @@
 
 namespace fs = std::filesystem;
 
-const std::vector<std::pair<std::string, std::optional<AuthorizationType>>> endpoint_map = {
-    { "/config", View },
-    { "/maps", View },
-    { "/control", Control },
-    { "/view", View },
-    { "/", std::nullopt }
-};
-
-std::optional<AuthorizationType> get_endpoint_permissions(
-    std::string_view path
-);
-
 std::string http_method_to_str(const http::verb& method);
 
 const std::size_t NONCE_SIZE = 32;
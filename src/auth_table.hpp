@@ -1,3 +1,6 @@
+#ifndef AUTH_TABLE_HPP
+#define AUTH_TABLE_HPP
+
 #include <vector>
 #include <string>
 #include <string_view>
@@ -5,6 +8,7 @@
 #include <unordered_map>
 #include <fstream>
 #include <filesystem>
+#include <iterator>
 
 enum AuthorizationType {
     Blocked = 0,
@@ -12,7 +16,7 @@ enum AuthorizationType {
     Control = 2,
 };
 
-std::string auth_type_to_str(AuthorizationType type) {
+inline std::string auth_type_to_str(AuthorizationType type) {
     if (type == Blocked)    return "Blocked";
     if (type == View)       return "View";
     if (type == Control)    return "Control";
@@ -33,7 +37,7 @@ struct auth_data {
 
 typedef std::unordered_map<std::string, auth_data> auth_table_t;
 
-std::vector<std::string> split_str(std::string input, char delimeter = ';') {
+inline std::vector<std::string> split_str(std::string input, char delimeter = ';') {
 	std::vector<std::string> result;
     if (input.size() == 0) {
         return result;
@@ -54,7 +58,7 @@ std::vector<std::string> split_str(std::string input, char delimeter = ';') {
     return result;
 }
 
-std::string join_vector(const std::vector<std::string>& vec, char delimeter = ';') {
+inline std::string join_vector(const std::vector<std::string>& vec, char delimeter = ';') {
     std::string result;
 
     for (auto it = vec.begin(); it != vec.end(); it++) {
@@ -67,7 +71,7 @@ std::string join_vector(const std::vector<std::string>& vec, char delimeter = ';
     return result;
 }
 
-std::optional<std::unordered_map<std::string, auth_data>>
+inline std::optional<std::unordered_map<std::string, auth_data>>
 open_auth_table_from_file(std::filesystem::path file_path) {
     std::ifstream file;
     file.open(file_path);
@@ -142,7 +146,7 @@ open_auth_table_from_file(std::filesystem::path file_path) {
     return auth_table;
 }
 
-void save_auth_table_to_file(std::filesystem::path path, const auth_table_t& table) {
+inline void save_auth_table_to_file(std::filesystem::path path, const auth_table_t& table) {
     std::ofstream file;
     file.open(path, std::ofstream::trunc | std::ofstream::out);
     if (!file.is_open()) {
@@ -158,8 +162,11 @@ void save_auth_table_to_file(std::filesystem::path path, const auth_table_t& tab
             join_vector(data.map_groups) << ":" <<
             data.password;
 
-        if (it != --table.end()) {
+        // the iterators of an unordered_map are only forward iterators
+        if (std::next(it) != table.end()) {
             file << std::endl;
         }
     }
 }
+
+#endif
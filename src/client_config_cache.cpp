@@ -0,0 +1,59 @@
+#include "client_config_cache.hpp"
+
+#include <algorithm>
+#include <cstdio>
+
+#include "gzip.hpp"
+
+client_config_cache::client_config_cache(std::shared_ptr<gc_config> config) :
+    config(config),
+    version(0)
+{
+    nlohmann::json maps = nlohmann::json::array();
+    for (const map_entry& map : config->maps) {
+        maps.push_back(map.to_json());
+    }
+
+    version = crc32(maps.dump());
+}
+
+const client_config_cache::rendered_config& client_config_cache::get(const auth_data& user_auth) const {
+    render_key key = std::nullopt;
+    if (user_auth.permissions >= Control) {
+        // the order of the groups doesn't change which maps pass
+        std::vector<std::string> groups = user_auth.map_groups;
+        std::sort(groups.begin(), groups.end());
+        groups.erase(std::unique(groups.begin(), groups.end()), groups.end());
+        key = std::move(groups);
+    }
+
+    std::lock_guard lock(renders_mutex);
+
+    const auto found = renders.find(key);
+    if (found != renders.end()) {
+        return found->second;
+    }
+
+    rendered_config render;
+    render.body = config->get_maps_for_client(user_auth);
+
+    char etag[24];
+    std::snprintf(
+        etag,
+        sizeof(etag),
+        "\"%08x-%08x\"",
+        static_cast<unsigned int>(version),
+        static_cast<unsigned int>(crc32(render.body))
+    );
+    render.etag = etag;
+    render.gzip_etag = render.etag.substr(0, render.etag.size() - 1) + "-gzip\"";
+
+    if (render.body.size() >= config->compression.min_size) {
+        std::string compressed = gzip_compress(render.body, config->compression.level);
+        if (compressed.size() < render.body.size()) {
+            render.gzip_body = std::move(compressed);
+        }
+    }
+
+    return renders.emplace(std::move(key), std::move(render)).first->second;
+}
@@ -0,0 +1,46 @@
+#ifndef CLIENT_CONFIG_CACHE_HPP
+#define CLIENT_CONFIG_CACHE_HPP
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <cstdint>
+
+#include "auth.hpp"
+#include "config.hpp"
+
+// the map config sent to the clients by /config, rendered once for every distinct set of maps
+// the users get, which only depends on their permissions and map groups,
+// the renders are never dropped, so they can be sent without copying,
+// the large ones are compressed once along with the render
+class client_config_cache {
+public:
+    struct rendered_config {
+        std::string body;
+        std::string etag;
+        // only kept if the body is large enough to compress and it got smaller
+        std::optional<std::string> gzip_body;
+        std::string gzip_etag;
+    };
+
+private:
+    std::shared_ptr<gc_config> config;
+    // a checksum of the maps of the config, so the ETags change along with it
+    std::uint32_t version;
+
+    // the users without control permissions see every map, they have no groups in the key
+    using render_key = std::optional<std::vector<std::string>>;
+
+    mutable std::mutex renders_mutex;
+    mutable std::map<render_key, rendered_config> renders;
+
+public:
+    explicit client_config_cache(std::shared_ptr<gc_config> config);
+
+    const rendered_config& get(const auth_data& user_auth) const;
+};
+
+#endif
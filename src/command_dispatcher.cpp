@@ -0,0 +1,87 @@
+#include "command_dispatcher.hpp"
+
+#include <algorithm>
+
+command_dispatcher::command_dispatcher(
+	std::shared_ptr<device_pool> devices,
+	std::shared_ptr<gc_config> config
+) : devices(devices),
+	config(config) {}
+
+bool command_dispatcher::dispatch(
+	json_message command,
+	const command_origin& origin,
+	dropped_handler on_dropped
+) const {
+	if (origin.permissions != Control) {
+		return false;
+	}
+
+	if (
+		command.type != json_message::ChangeState &&
+		command.type != json_message::ChangeStateBatch &&
+		command.type != json_message::QueryState
+	) {
+		return false;
+	}
+
+	// the whole batch is authorized at once, and checked like the scenes of the config
+	if (
+		command.type == json_message::ChangeStateBatch &&
+		(!resolve_scene(command, origin) || !gc_config::validate_batch(command.payload))
+	) {
+		return false;
+	}
+
+	// the operators' commands go ahead of the state queries on the serial link
+	const MessagePriority priority = command.type == json_message::QueryState ? Routine : Urgent;
+
+	std::optional<arduino_messenger::clock::time_point> deadline;
+	if (auto timeout = config->get_command_deadline(json_message::type_to_str(command.type))) {
+		deadline = arduino_messenger::clock::now() + timeout.value();
+	}
+
+	arduino_messenger::expired_handler on_expired = nullptr;
+	if (on_dropped) {
+		on_expired = [on_dropped](const json_message& expired) {
+			on_dropped(json_message::Expired, expired);
+		};
+	}
+
+	// tell the origin right away instead of letting the command wait,
+	// about the gates of the busy devices only, since the other ones still get the command
+	const auto rejected = devices->send_message(command, priority, origin.username, deadline, on_expired);
+	if (rejected && on_dropped) {
+		on_dropped(json_message::Busy, rejected.value());
+	}
+
+	return true;
+}
+
+bool command_dispatcher::resolve_scene(json_message& batch, const command_origin& origin) const {
+	if (!batch.payload.is_object() || !batch.payload.contains("scene")) {
+		return true;
+	}
+
+	if (!batch.payload["map"].is_string() || !batch.payload["scene"].is_string()) {
+		return false;
+	}
+
+	const map_entry& map = config->get_map_by_id(batch.payload["map"].get<std::string>());
+
+	// maps with a group can only be controlled by it's members
+	if (
+		map.group &&
+		std::find(origin.map_groups.begin(), origin.map_groups.end(), map.group.value()) == origin.map_groups.end()
+	) {
+		return false;
+	}
+
+	const std::string scene = batch.payload["scene"];
+	if (!map.scenes.contains(scene)) {
+		return false;
+	}
+
+	batch.payload = map.scenes[scene];
+	return true;
+}
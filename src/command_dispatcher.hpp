@@ -0,0 +1,52 @@
+#ifndef COMMAND_DISPATCHER_HPP
+#define COMMAND_DISPATCHER_HPP
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <functional>
+
+#include "json_message.hpp"
+#include "device_pool.hpp"
+#include "config.hpp"
+#include "auth.hpp"
+
+// who a command comes from, which decides what it's allowed to do
+struct command_origin {
+	AuthorizationType permissions = Blocked;
+	// the commands are queued fairly between the users
+	std::string username;
+	// the groups of maps the user can control
+	std::vector<std::string> map_groups;
+};
+
+// the authorized path of the gate commands to the devices,
+// shared by the clients and the scheduled jobs
+class command_dispatcher {
+	std::shared_ptr<device_pool> devices;
+	std::shared_ptr<gc_config> config;
+
+public:
+	// called with Busy or Expired when a command won't reach the devices
+	using dropped_handler = std::function<void(json_message::MessageType reason, const json_message& command)>;
+
+	command_dispatcher(
+		std::shared_ptr<device_pool> devices,
+		std::shared_ptr<gc_config> config
+	);
+
+	// sends the command to the devices if the origin is allowed to,
+	// returns false if it isn't a command or the origin can't send it
+	bool dispatch(
+		json_message command,
+		const command_origin& origin,
+		dropped_handler on_dropped = nullptr
+	) const;
+
+private:
+	// replaces a scene reference in a change_state_batch with the scene's gates,
+	// returns false if the origin can't control the scene's map
+	bool resolve_scene(json_message& batch, const command_origin& origin) const;
+};
+
+#endif
@@ -2,61 +2,400 @@
 
 common_state::common_state(
 	net::io_context& io,
-	std::shared_ptr<arduino_messenger> messenger
-) : io(io.get_executor()), messenger(messenger) {}
+	std::shared_ptr<device_pool> devices
+) : devices(devices),
+	gate_states(devices->get_gate_ids()),
+	update_strand(net::make_strand(io)),
+	progress_timer(update_strand),
+	poll_timer(io) {}
 
 void common_state::add_session(
-	std::shared_ptr<websocket_session> session
+	std::shared_ptr<websocket_session> session,
+	std::optional<std::uint64_t> known_state_version
 ) {
+	std::vector<unsigned int> unknown_ids;
+
 	{
 		std::lock_guard lock(sessions_mutex);
-		sessions.push_back(session);
+
+		// when clients reconnect, the new sessions get the pooled memory of the ones they replace
+		remove_dead_sessions();
+		sessions.push_back({ session, clock::time_point() });
+
+		// the new session gets the known states right away,
+		// only the gates nobody has heard from yet are queried
+		if (known_state_version != state_version) {
+			nlohmann::json known_states = gate_states.to_json();
+			if (!known_states.empty()) {
+				session->queue_message(json_message(json_message::QueryStateResult, known_states).dump_message());
+			}
+		}
+
+		const std::vector<unsigned int> stuck_ids = get_stuck_ids();
+		if (!stuck_ids.empty()) {
+			session->queue_message(json_message(json_message::Stuck, stuck_ids).dump_message());
+		}
+
+		unknown_ids = gate_states.get_unknown_ids();
 	}
 
-	messenger->send_message(json_message(json_message::QueryState, { 0, 1, 2, 3, 4, 5, 6 }));
+	if (!unknown_ids.empty()) {
+		devices->send_message(json_message(json_message::QueryState, unknown_ids), Routine);
+	}
 }
 
-void common_state::run() {
-	update();
+common_state::gate_snapshot common_state::get_snapshot() {
+	std::lock_guard lock(sessions_mutex);
+	return { gate_states.to_json(), state_version };
 }
 
-void common_state::update() {
-	if (sessions.size() > 0) {
-		// remove all dead sessions
-		{
-			std::lock_guard lock(sessions_mutex);
-
-			sessions.erase(
-				std::remove_if(
-					sessions.begin(),
-					sessions.end(),
-					[](std::weak_ptr<websocket_session>& s) { return s.expired(); }
-				),
-				sessions.end()
-			);
-		}
-
-		// update all sessions with new state
-		if (!messenger->incoming_message_queue.empty()) {
-			json_message message = messenger->incoming_message_queue.front();
-			if (message.type == json_message::QueryStateResult) {
-				for (auto& session : sessions) {
-					if (std::shared_ptr<websocket_session> sp = session.lock()) {
-						sp->queue_message(
-							messenger->incoming_message_queue.front().dump_message()
-						);
-					}
-				}
-				messenger->incoming_message_queue.pop();
+void common_state::run() {
+	// fill the state table before the first session arrives
+	devices->send_message(json_message(json_message::QueryState, devices->get_gate_ids()), Background);
+
+	// the devices tell when they receive something, instead of their queues being checked all the time
+	devices->set_message_handler(
+		[weak_self = weak_from_this()] {
+			if (const auto self = weak_self.lock()) {
+				self->post_update();
 			}
 		}
+	);
+
+	do_poll(MIN_IDLE_POLL_INTERVAL);
+	post_update();
+}
+
+void common_state::post_update() {
+	// the messages received while an update is posted are handled by it
+	if (is_update_posted.exchange(true)) {
+		return;
 	}
 
 	net::post(
-		io,
+		update_strand,
 		std::bind(
 			&common_state::update,
 			shared_from_this()
 		)
 	);
 }
+
+void common_state::on_progress_timer(const boost::system::error_code& ec) {
+	if (ec) {
+		return;
+	}
+
+	update();
+}
+
+void common_state::do_poll(clock::duration interval) {
+	poll_timer.expires_after(interval);
+	poll_timer.async_wait(
+		std::bind(
+			&common_state::on_poll,
+			shared_from_this(),
+			std::placeholders::_1
+		)
+	);
+}
+
+void common_state::on_poll(const boost::system::error_code& ec) {
+	if (ec) {
+		return;
+	}
+
+	std::vector<unsigned int> ids;
+	clock::duration next_interval;
+
+	{
+		std::lock_guard lock(sessions_mutex);
+
+		check_stuck_gates();
+
+		// the moving gates are polled often until they stop, the stuck ones are left to the idle polls
+		for (const auto& [id, gate] : moving_gates) {
+			if (!gate.is_stuck) {
+				ids.push_back(id);
+			}
+		}
+
+		if (!ids.empty()) {
+			idle_poll_interval = MIN_IDLE_POLL_INTERVAL;
+			next_interval = MOVING_POLL_INTERVAL;
+		}
+		else {
+			// back off while nothing changes, to catch drift at little cost
+			if (states_changed) {
+				idle_poll_interval = MIN_IDLE_POLL_INTERVAL;
+			}
+			else {
+				idle_poll_interval = std::min(idle_poll_interval * 2, MAX_IDLE_POLL_INTERVAL);
+			}
+
+			ids = devices->get_gate_ids();
+			next_interval = idle_poll_interval;
+		}
+
+		states_changed = false;
+	}
+
+	// a saturated link is left alone, it's gates are polled once it drains
+	const std::vector<unsigned int> pollable_ids = devices->get_gate_ids_below_depth(MAX_POLL_DEPTH);
+	std::erase_if(
+		ids,
+		[&pollable_ids](unsigned int id) {
+			return !std::binary_search(pollable_ids.begin(), pollable_ids.end(), id);
+		}
+	);
+
+	if (!ids.empty()) {
+		devices->send_message(json_message(json_message::QueryState, ids), Background);
+	}
+
+	do_poll(next_interval);
+}
+
+void common_state::update_movements(const json_message& message) {
+	const auto now = clock::now();
+
+	if (message.type == json_message::QueryStateResult && message.payload.is_array()) {
+		for (const auto& gate : message.payload) {
+			if (
+				!gate.is_object() ||
+				!gate.value("id", nlohmann::json()).is_number_unsigned() ||
+				!gate.value("state", nlohmann::json()).is_string()
+			) {
+				continue;
+			}
+
+			const unsigned int id = gate["id"];
+			const auto state = gate_state_table::str_to_state(gate["state"].get<std::string>());
+			if (!state) {
+				continue;
+			}
+
+			if (state == gate_state_table::Raised || state == gate_state_table::Lowered) {
+				const auto found = moving_gates.find(id);
+				if (found != moving_gates.end() && found->second.is_stuck) {
+					std::cout << "Gate " << id << " is no longer stuck." << std::endl;
+				}
+				moving_gates.erase(id);
+				continue;
+			}
+
+			// a gate turning around starts moving anew
+			const auto found = moving_gates.find(id);
+			if (found == moving_gates.end() || found->second.state != state.value()) {
+				moving_gates.insert_or_assign(id, movement{ state.value(), now });
+			}
+		}
+	}
+	else if (message.type == json_message::Availability && message.payload.contains("gates")) {
+		for (const auto& id : message.payload["gates"]) {
+			moving_gates.erase(id.get<unsigned int>());
+		}
+	}
+}
+
+void common_state::check_stuck_gates() {
+	const auto now = clock::now();
+	std::vector<unsigned int> stuck_ids;
+
+	for (auto& [id, gate] : moving_gates) {
+		if (gate.is_stuck || now - gate.since < devices->get_travel_time(id) * STUCK_TRAVEL_FACTOR) {
+			continue;
+		}
+
+		gate.is_stuck = true;
+		stuck_ids.push_back(id);
+
+		std::cerr
+			<< "Gate " << id << " has been "
+			<< gate_state_table::state_to_str(gate.state) << " for "
+			<< std::chrono::duration_cast<std::chrono::seconds>(now - gate.since).count()
+			<< " seconds, it may be stuck." << std::endl;
+	}
+
+	if (stuck_ids.empty()) {
+		return;
+	}
+
+	const std::string dumped_message = json_message(json_message::Stuck, stuck_ids).dump_message();
+	for (auto& entry : sessions) {
+		if (std::shared_ptr<websocket_session> sp = entry.session.lock()) {
+			sp->queue_message(dumped_message);
+		}
+	}
+}
+
+void common_state::remove_dead_sessions() {
+	sessions.erase(
+		std::remove_if(
+			sessions.begin(),
+			sessions.end(),
+			[](session_entry& s) { return s.session.expired(); }
+		),
+		sessions.end()
+	);
+}
+
+std::vector<unsigned int> common_state::get_stuck_ids() const {
+	std::vector<unsigned int> ids;
+
+	for (const auto& [id, gate] : moving_gates) {
+		if (gate.is_stuck) {
+			ids.push_back(id);
+		}
+	}
+
+	return ids;
+}
+
+void common_state::update() {
+	// a message queued from now on posts another update
+	is_update_posted = false;
+
+	std::optional<clock::time_point> next_progress_time;
+
+	{
+		std::lock_guard lock(sessions_mutex);
+
+		remove_dead_sessions();
+
+		// keep the state table current and update all sessions with new state from every device
+		while (auto message = devices->pop_message()) {
+			// the positions are sent separately at the rate of each session
+			if (message->type == json_message::Progress) {
+				update_positions(message.value());
+				continue;
+			}
+
+			if (message->type == json_message::QueryStateResult) {
+				if (gate_states.update(message->payload)) {
+					states_changed = true;
+					state_version++;
+				}
+				update_positions(message.value());
+				update_movements(message.value());
+			}
+			else if (message->type == json_message::Availability) {
+				if (!message->payload["available"].get<bool>()) {
+					update_positions(message.value());
+					update_movements(message.value());
+					gate_states.forget(message->payload["gates"].get<std::vector<unsigned int>>());
+					states_changed = true;
+					state_version++;
+				}
+			}
+			else {
+				continue;
+			}
+
+			if (sessions.empty()) {
+				continue;
+			}
+
+			const std::string dumped_message = message->dump_message();
+			for (auto& entry : sessions) {
+				if (std::shared_ptr<websocket_session> sp = entry.session.lock()) {
+					sp->queue_message(dumped_message);
+				}
+			}
+		}
+
+		next_progress_time = send_positions();
+	}
+
+	if (next_progress_time) {
+		progress_timer.expires_at(next_progress_time.value());
+		progress_timer.async_wait(
+			std::bind(
+				&common_state::on_progress_timer,
+				shared_from_this(),
+				std::placeholders::_1
+			)
+		);
+	}
+	else {
+		progress_timer.cancel();
+	}
+}
+
+
+void common_state::update_positions(const json_message& message) {
+	if (message.type == json_message::Progress && message.payload.is_array()) {
+		for (const auto& gate : message.payload) {
+			if (
+				gate.is_object() &&
+				gate.value("id", nlohmann::json()).is_number_unsigned() &&
+				gate.value("position", nlohmann::json()).is_number_unsigned()
+			) {
+				gate_positions[gate["id"].get<unsigned int>()] = gate["position"].get<unsigned int>();
+				positions_time = clock::now();
+			}
+		}
+	}
+	// the gates that stopped or became unavailable have no position to report
+	else if (message.type == json_message::QueryStateResult && message.payload.is_array()) {
+		for (const auto& gate : message.payload) {
+			if (!gate.is_object() || !gate.value("id", nlohmann::json()).is_number_unsigned()) {
+				continue;
+			}
+
+			const std::string state = gate.value("state", "");
+			if (state == "raised" || state == "lowered") {
+				gate_positions.erase(gate["id"].get<unsigned int>());
+			}
+		}
+	}
+	else if (message.type == json_message::Availability && message.payload.contains("gates")) {
+		for (const auto& id : message.payload["gates"]) {
+			gate_positions.erase(id.get<unsigned int>());
+		}
+	}
+}
+
+std::optional<common_state::clock::time_point> common_state::send_positions() {
+	if (gate_positions.empty()) {
+		return std::nullopt;
+	}
+
+	const auto now = clock::now();
+	std::string dumped_message;
+	std::optional<clock::time_point> next_time;
+
+	for (auto& entry : sessions) {
+		std::shared_ptr<websocket_session> sp = entry.session.lock();
+		if (!sp) {
+			continue;
+		}
+
+		const unsigned int rate = sp->get_progress_rate();
+		if (rate == 0 || entry.progress_time >= positions_time) {
+			continue;
+		}
+
+		// the session gets the latest positions once it's due, even if no newer ones arrive by then
+		const clock::time_point due_time = entry.progress_time + clock::duration(std::chrono::seconds(1)) / rate;
+		if (now < due_time) {
+			next_time = next_time ? std::min(next_time.value(), due_time) : due_time;
+			continue;
+		}
+
+		// only dumped if some session is due
+		if (dumped_message.empty()) {
+			nlohmann::json payload = nlohmann::json::array();
+			for (const auto& [id, position] : gate_positions) {
+				payload.push_back({ { "id", id }, { "position", position } });
+			}
+
+			dumped_message = json_message(json_message::Progress, payload).dump_message();
+		}
+
+		sp->queue_message(dumped_message);
+		entry.progress_time = now;
+	}
+
+	return next_time;
+}
@@ -3,32 +3,120 @@
 
 #include <memory>
 #include <vector>
+#include <map>
+#include <chrono>
+#include <optional>
+#include <cstdint>
+#include <atomic>
 
 #include "common.hpp"
 
-#include <boost/asio/any_io_executor.hpp>
 #include <boost/asio/ip/tcp.hpp>
 #include <boost/asio/io_context.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/strand.hpp>
+#include <boost/asio/post.hpp>
 
 #include "websocket_session.hpp"
-#include "arduino_messenger.hpp"
+#include "device_pool.hpp"
+#include "gate_state_table.hpp"
 
 class common_state : public std::enable_shared_from_this<common_state> {
-	net::any_io_executor io;
-	std::vector<std::weak_ptr<websocket_session>> sessions;
+	using clock = std::chrono::steady_clock;
+
+	// while gates move, they are polled this often to notice when they stop or get stuck
+	static constexpr clock::duration MOVING_POLL_INTERVAL = std::chrono::seconds(1);
+	// otherwise all gates are polled, less often the longer nothing changes
+	static constexpr clock::duration MIN_IDLE_POLL_INTERVAL = std::chrono::seconds(10);
+	static constexpr clock::duration MAX_IDLE_POLL_INTERVAL = std::chrono::minutes(5);
+	// the devices with more messages waiting to be written aren't polled
+	static constexpr std::size_t MAX_POLL_DEPTH = 2;
+	// a gate moving for this many times it's travel time is reported as stuck
+	static constexpr unsigned int STUCK_TRAVEL_FACTOR = 3;
+
+	struct movement {
+		gate_state_table::gate_state state;
+		clock::time_point since;
+		bool is_stuck = false;
+	};
+
+	struct session_entry {
+		std::weak_ptr<websocket_session> session;
+		// when the session was last sent the gate positions
+		clock::time_point progress_time;
+	};
+
+	std::vector<session_entry> sessions;
 	std::mutex sessions_mutex;
-	std::shared_ptr<arduino_messenger> messenger;
+	std::shared_ptr<device_pool> devices;
+
+	// guarded by sessions_mutex
+	gate_state_table gate_states;
+	// counts the changes of the state table, so a page that embedded the states doesn't get them again
+	std::uint64_t state_version = 0;
+	// the latest position (in percent) of every moving gate
+	std::map<unsigned int, unsigned int> gate_positions;
+	clock::time_point positions_time;
+	// the gates last reported raising or lowering
+	std::map<unsigned int, movement> moving_gates;
+	// whether any state changed since the previous poll
+	bool states_changed = false;
+
+	// the received messages are handled on the strand as they arrive, a single update is posted at a time
+	net::strand<net::io_context::executor_type> update_strand;
+	std::atomic<bool> is_update_posted = false;
+	// wakes the strand when a session is due for positions it was passed over for, only while there are any
+	net::steady_timer progress_timer;
+
+	net::steady_timer poll_timer;
+	// only accessed from the poll timer's handler
+	clock::duration idle_poll_interval = MIN_IDLE_POLL_INTERVAL;
 
 public:
+	struct gate_snapshot {
+		// a query_state_result payload
+		nlohmann::json states;
+		std::uint64_t version;
+	};
+
 	common_state(
 		net::io_context& io,
-		std::shared_ptr<arduino_messenger> messenger
+		std::shared_ptr<device_pool> devices
+	);
+
+	// a session of a page that embedded the states of the given version only gets them if they changed since
+	void add_session(
+		std::shared_ptr<websocket_session> session,
+		std::optional<std::uint64_t> known_state_version = std::nullopt
 	);
 
-	void add_session(std::shared_ptr<websocket_session> session);
+	// the known gate states, to embed into a page
+	gate_snapshot get_snapshot();
 
 	void run();
 	void update();
+
+private:
+	// posts an update to the strand, unless one is posted already, callable from any thread
+	void post_update();
+	void on_progress_timer(const boost::system::error_code& ec);
+	void do_poll(clock::duration interval);
+	void on_poll(const boost::system::error_code& ec);
+	// keeps the time every gate started moving, expects sessions_mutex to be locked
+	void update_movements(const json_message& message);
+	// flags the gates that have been moving for too long and tells the sessions about them,
+	// expects sessions_mutex to be locked
+	void check_stuck_gates();
+	// drops the entries of the finished sessions, whose memory is only freed with the last weak pointer to it,
+	// expects sessions_mutex to be locked
+	void remove_dead_sessions();
+	// the gates flagged as stuck
+	std::vector<unsigned int> get_stuck_ids() const;
+
+	void update_positions(const json_message& message);
+	// sends the gate positions to the sessions that are due for them at their requested rate,
+	// returns when the next session that was passed over is due
+	std::optional<clock::time_point> send_positions();
 };
 
 #endif
\ No newline at end of file
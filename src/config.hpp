@@ -7,6 +7,11 @@
 #include <fstream>
 #include <optional>
 #include <initializer_list>
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <regex>
+#include <array>
 #include "auth.hpp"
 
 namespace fs = std::filesystem;
@@ -16,16 +21,20 @@ struct map_entry {
 	std::optional<std::string> group;
 	std::string map_image_path;
 	nlohmann::json gate_config;
+	// named sets of gates to raise and lower at once, by name
+	nlohmann::json scenes;
 
 	map_entry(
 		std::string id,
 		std::optional<std::string> group,
 		std::string map_image_path,
-		nlohmann::json gate_config
+		nlohmann::json gate_config,
+		nlohmann::json scenes = nlohmann::json::object()
 	) : id(id), 
 		group(group),
 		map_image_path(map_image_path), 
-		gate_config(gate_config) {}
+		gate_config(gate_config),
+		scenes(scenes) {}
 
 	nlohmann::json to_json() const {
 		nlohmann::json group_value = nullptr;
@@ -37,7 +46,8 @@ struct map_entry {
 			{ "id", id },
 			{ "group", group_value },
 			{ "mapImage", map_image_path },
-			{ "gates", gate_config }
+			{ "gates", gate_config },
+			{ "scenes", scenes }
 		};
 	}
 
@@ -50,20 +60,212 @@ struct map_entry {
 		return {
 			{ "id", id },
 			{ "group", group_value },
-			{ "gates", gate_config }
+			{ "gates", gate_config },
+			{ "scenes", scenes }
 		};
 	}
 };
 
+// maps a global gate id (the one used in map entries and by the clients)
+// to a gate id local to the device it's connected to
+struct gate_route {
+	unsigned int gate_id;
+	unsigned int local_id;
+};
+
+// the serial port settings of a device
+struct serial_options {
+	static constexpr unsigned int DEFAULT_BAUD_RATE = 115200;
+
+	unsigned int baud_rate = DEFAULT_BAUD_RATE;
+	// asks the driver to deliver received bytes without buffering them
+	// (on Linux, sets ASYNC_LOW_LATENCY and the USB-serial adapter's latency timer)
+	bool low_latency = true;
+	// disables all line processing of the terminal (Unix-like systems only)
+	bool raw = true;
+	// the size of a single read from the port, which is the size of the port's read buffer
+	std::size_t read_burst_size = 512;
+	static constexpr std::size_t MAX_READ_BURST_SIZE = 65536;
+};
+
+// the gates the firmware can drive
+struct firmware_limits {
+	// the size of the firmware's gate table, a config with more pins is refused by the device
+	static constexpr unsigned int MAX_GATES = 32;
+	// the gates that have a pin without a config
+	static constexpr unsigned int DEFAULT_GATE_COUNT = 7;
+};
+
+// how the generated responses are compressed for the clients that accept gzip
+struct compression_options {
+	// smaller bodies aren't worth compressing
+	static constexpr std::size_t DEFAULT_MIN_SIZE = 1024;
+	static constexpr int DEFAULT_LEVEL = 6;
+	static constexpr int MAX_LEVEL = 9;
+
+	std::size_t min_size = DEFAULT_MIN_SIZE;
+	// from 0 (no compression) to 9 (best compression)
+	int level = DEFAULT_LEVEL;
+};
+
+struct device_entry {
+	// how often the device reports the position of moving gates, 0 disables the reports
+	static constexpr unsigned int DEFAULT_PROGRESS_INTERVAL = 50;
+	// how long the firmware's gates take to fully raise or lower
+	static constexpr unsigned int DEFAULT_TRAVEL_TIME = 1000;
+
+	std::string id;
+	std::string port;
+	serial_options serial;
+	std::vector<gate_route> routes;
+	// the pin of every local gate, the firmware's default pins are used if not set
+	std::optional<std::vector<unsigned int>> pins;
+	// in milliseconds
+	unsigned int progress_interval;
+	// in milliseconds, the gates moving for much longer are reported as stuck
+	unsigned int travel_time;
+
+	device_entry(
+		std::string id,
+		std::string port,
+		serial_options serial,
+		std::vector<gate_route> routes,
+		std::optional<std::vector<unsigned int>> pins = std::nullopt,
+		unsigned int progress_interval = DEFAULT_PROGRESS_INTERVAL,
+		unsigned int travel_time = DEFAULT_TRAVEL_TIME
+	) : id(id),
+		port(port),
+		serial(serial),
+		routes(routes),
+		pins(pins),
+		progress_interval(progress_interval),
+		travel_time(travel_time) {}
+
+	// a single device on the given port, which has every gate routed to the same local id
+	static device_entry make_default(
+		std::string port,
+		const std::vector<unsigned int>& gate_ids
+	) {
+		std::vector<gate_route> routes;
+		for (unsigned int id : gate_ids) {
+			routes.push_back({ id, id });
+		}
+
+		return device_entry("default", port, serial_options(), routes);
+	}
+};
+
+// a gate command the server sends on it's own at set times
+struct schedule_entry {
+	struct time_of_day {
+		unsigned int hour;
+		unsigned int minute;
+	};
+
+	struct calendar_date {
+		int year;
+		unsigned int month;
+		unsigned int day;
+	};
+
+	static constexpr std::array<const char*, 7> WEEKDAY_NAMES = { "sun", "mon", "tue", "wed", "thu", "fri", "sat" };
+
+	std::string id;
+	// the command is authorized as this user
+	std::string user;
+	// a message in the format the clients send, like { "type": "change_state", "payload": ... }
+	nlohmann::json command;
+	// runs every this many seconds
+	std::optional<unsigned int> every;
+	// or at this local time
+	std::optional<time_of_day> at;
+	// only on this date, once
+	std::optional<calendar_date> date;
+	// a bit per day of the week starting from sunday, every day if none are set
+	unsigned int weekdays = 0;
+
+	// "HH:MM" in the 24-hour format
+	static std::optional<time_of_day> parse_time_of_day(const std::string& str) {
+		static const std::regex time_regex(R"(^([01][0-9]|2[0-3]):([0-5][0-9])$)");
+
+		std::smatch match;
+		if (!std::regex_match(str, match, time_regex)) {
+			return std::nullopt;
+		}
+
+		return time_of_day{
+			static_cast<unsigned int>(std::stoul(match[1])),
+			static_cast<unsigned int>(std::stoul(match[2]))
+		};
+	}
+
+	// "YYYY-MM-DD"
+	static std::optional<calendar_date> parse_date(const std::string& str) {
+		static const std::regex date_regex(R"(^([0-9]{4})-(0[1-9]|1[0-2])-(0[1-9]|[12][0-9]|3[01])$)");
+
+		std::smatch match;
+		if (!std::regex_match(str, match, date_regex)) {
+			return std::nullopt;
+		}
+
+		const calendar_date date{
+			std::stoi(match[1]),
+			static_cast<unsigned int>(std::stoul(match[2])),
+			static_cast<unsigned int>(std::stoul(match[3]))
+		};
+
+		// the regex allows up to 31 days in any month, mktime would move a day like 02-30 into the next one
+		if (date.day > days_in_month(date.year, date.month)) {
+			return std::nullopt;
+		}
+
+		return date;
+	}
+
+	static unsigned int days_in_month(int year, unsigned int month) {
+		static constexpr std::array<unsigned int, 12> DAYS = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+
+		const bool leap_year = (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+		if (month == 2 && leap_year) {
+			return 29;
+		}
+
+		return DAYS[month - 1];
+	}
+
+	static std::optional<unsigned int> parse_weekday(const std::string& str) {
+		for (unsigned int i = 0; i < WEEKDAY_NAMES.size(); i++) {
+			if (str == WEEKDAY_NAMES[i]) {
+				return i;
+			}
+		}
+
+		return std::nullopt;
+	}
+};
+
 struct gc_config {
 	struct parse_error : public std::runtime_error {
 		parse_error(const char* why) : std::runtime_error(why) {}
 	};
 
 	std::vector<map_entry> maps;
+	std::vector<device_entry> devices;
+	// how long a command of a type can wait for the serial link before it's dropped,
+	// the types without one wait indefinitely
+	std::map<std::string, std::chrono::milliseconds> command_deadlines = {
+		{ "change_state", std::chrono::milliseconds(2000) },
+		{ "change_state_batch", std::chrono::milliseconds(2000) },
+		{ "query_state", std::chrono::milliseconds(5000) }
+	};
+	std::vector<schedule_entry> schedule;
+	compression_options compression;
 
 	gc_config(std::initializer_list<map_entry> maps = {}) : maps(maps) {}
-	gc_config(std::vector<map_entry> maps = {}) : maps(maps) {}
+	gc_config(
+		std::vector<map_entry> maps,
+		std::vector<device_entry> devices = {}
+	) : maps(maps), devices(devices) {}
 
 	static bool validate_gate_entry(nlohmann::json entry) {
 		return
@@ -73,37 +275,262 @@ struct gc_config {
 			entry["id"].is_number_unsigned();
 	}
 
+	// a set of gates to raise and lower at once, the payload of a change_state_batch message
+	static bool validate_batch(nlohmann::json batch) {
+		if (!batch.is_object()) {
+			return false;
+		}
+
+		// a gate listed twice would be raised and lowered in the same pass,
+		// with a result depending on the order of the lists
+		std::vector<unsigned int> ids;
+		for (const char* key : { "raise", "lower" }) {
+			if (!batch[key].is_array() && !batch[key].is_null()) {
+				return false;
+			}
+
+			for (auto id : batch[key]) {
+				if (!id.is_number_unsigned()) {
+					return false;
+				}
+
+				if (std::find(ids.begin(), ids.end(), id.get<unsigned int>()) != ids.end()) {
+					return false;
+				}
+				ids.push_back(id);
+			}
+		}
+
+		return true;
+	}
+
 	static bool validate_map_entry(nlohmann::json entry) {
 		if (
 			!entry.is_object() ||
 			!entry["id"].is_string() ||
 			(!entry["group"].is_string() && !entry["group"].is_null()) ||
 			!entry["mapImage"].is_string() ||
-			!entry["gates"].is_array()
+			!entry["gates"].is_array() ||
+			(!entry["scenes"].is_object() && !entry["scenes"].is_null())
 		) {
 			return false;
 		}
 
+		std::vector<unsigned int> gate_ids;
 		for (auto gate : entry["gates"]) {
 			if (!validate_gate_entry(gate)) {
 				return false;
 			}
+			gate_ids.push_back(gate["id"]);
+		}
+
+		// a scene can only move the gates on it's map
+		for (auto scene : entry["scenes"]) {
+			if (!validate_batch(scene)) {
+				return false;
+			}
+
+			for (const char* key : { "raise", "lower" }) {
+				for (auto id : scene[key]) {
+					if (std::find(gate_ids.begin(), gate_ids.end(), id.get<unsigned int>()) == gate_ids.end()) {
+						return false;
+					}
+				}
+			}
+		}
+
+		return true;
+	}
+
+	static bool validate_serial_options(nlohmann::json entry) {
+		if (entry.is_null()) {
+			return true;
+		}
+
+		return
+			entry.is_object() &&
+			(entry["lowLatency"].is_boolean() || entry["lowLatency"].is_null()) &&
+			(entry["raw"].is_boolean() || entry["raw"].is_null()) &&
+			(
+				(
+					entry["readBurstSize"].is_number_unsigned() &&
+					entry["readBurstSize"] > 0 &&
+					entry["readBurstSize"] <= serial_options::MAX_READ_BURST_SIZE
+				) ||
+				entry["readBurstSize"].is_null()
+			);
+	}
+
+	static bool validate_device_entry(nlohmann::json entry) {
+		if (
+			!entry.is_object() ||
+			!entry["id"].is_string() ||
+			!entry["port"].is_string() ||
+			(!entry["baudRate"].is_null() && (!entry["baudRate"].is_number_unsigned() || entry["baudRate"] == 0)) ||
+			!validate_serial_options(entry["serial"]) ||
+			(!entry["pins"].is_array() && !entry["pins"].is_null()) ||
+			(!entry["progressInterval"].is_number_unsigned() && !entry["progressInterval"].is_null()) ||
+			(!entry["travelTime"].is_null() && (!entry["travelTime"].is_number_unsigned() || entry["travelTime"] == 0)) ||
+			!entry["gates"].is_array()
+		) {
+			return false;
+		}
+
+		if (entry["pins"].is_array() && entry["pins"].size() > firmware_limits::MAX_GATES) {
+			return false;
+		}
+
+		for (auto pin : entry["pins"]) {
+			if (!pin.is_number_unsigned() || pin > 255) {
+				return false;
+			}
+		}
+
+		std::vector<unsigned int> local_ids;
+		for (auto route : entry["gates"]) {
+			if (
+				!route.is_object() ||
+				!route["id"].is_number_unsigned() ||
+				!route["local"].is_number_unsigned()
+			) {
+				return false;
+			}
+
+			// a local gate can only be routed once, and has to have a pin,
+			// either a listed one or one of the firmware's defaults
+			unsigned int local_id = route["local"];
+			const std::size_t pin_count =
+				entry["pins"].is_array() ? entry["pins"].size() : firmware_limits::DEFAULT_GATE_COUNT;
+			if (local_id >= pin_count) {
+				return false;
+			}
+
+			if (std::find(local_ids.begin(), local_ids.end(), local_id) != local_ids.end()) {
+				return false;
+			}
+			local_ids.push_back(local_id);
+		}
+
+		return true;
+	}
+
+	static bool validate_schedule_entry(nlohmann::json entry) {
+		if (
+			!entry.is_object() ||
+			!entry["id"].is_string() ||
+			!entry["user"].is_string() ||
+			!entry["command"].is_object() ||
+			!entry["command"]["type"].is_string() ||
+			(!entry["every"].is_number_unsigned() && !entry["every"].is_null()) ||
+			(!entry["at"].is_string() && !entry["at"].is_null()) ||
+			(!entry["date"].is_string() && !entry["date"].is_null()) ||
+			(!entry["days"].is_array() && !entry["days"].is_null())
+		) {
+			return false;
+		}
+
+		// only the commands a client with control permissions can send
+		const std::string type = entry["command"]["type"];
+		if (type != "change_state" && type != "change_state_batch" && type != "query_state") {
+			return false;
+		}
+
+		// a job either repeats every few seconds, or runs at a time of day
+		if (entry["every"].is_number_unsigned()) {
+			return
+				entry["every"] > 0 &&
+				entry["at"].is_null() &&
+				entry["date"].is_null() &&
+				entry["days"].is_null();
+		}
+
+		if (!entry["at"].is_string() || !schedule_entry::parse_time_of_day(entry["at"])) {
+			return false;
+		}
+
+		if (entry["date"].is_string()) {
+			return entry["days"].is_null() && schedule_entry::parse_date(entry["date"]);
+		}
+
+		for (auto day : entry["days"]) {
+			if (!day.is_string() || !schedule_entry::parse_weekday(day)) {
+				return false;
+			}
 		}
 
 		return true;
 	}
 
 	static bool validate_config(nlohmann::json config_json) {
-		if (!config_json.is_array()) {
+		// the legacy format is just an array of maps
+		if (config_json.is_array()) {
+			config_json = { { "maps", config_json } };
+		}
+
+		if (
+			!config_json.is_object() ||
+			!config_json["maps"].is_array() ||
+			(!config_json["devices"].is_array() && !config_json["devices"].is_null()) ||
+			(!config_json["commandDeadlines"].is_object() && !config_json["commandDeadlines"].is_null()) ||
+			(!config_json["schedule"].is_array() && !config_json["schedule"].is_null()) ||
+			(!config_json["compression"].is_object() && !config_json["compression"].is_null())
+		) {
 			return false;
 		}
 
-		for (auto map : config_json) {
+		nlohmann::json compression_json = config_json["compression"];
+		if (
+			compression_json.is_object() &&
+			(
+				(!compression_json["minSize"].is_number_unsigned() && !compression_json["minSize"].is_null()) ||
+				(!compression_json["level"].is_number_unsigned() && !compression_json["level"].is_null()) ||
+				(compression_json["level"].is_number_unsigned() && compression_json["level"] > compression_options::MAX_LEVEL)
+			)
+		) {
+			return false;
+		}
+
+		std::vector<std::string> job_ids;
+		for (auto job : config_json["schedule"]) {
+			if (!validate_schedule_entry(job)) {
+				return false;
+			}
+
+			const std::string job_id = job["id"];
+			if (std::find(job_ids.begin(), job_ids.end(), job_id) != job_ids.end()) {
+				return false;
+			}
+			job_ids.push_back(job_id);
+		}
+
+		for (auto deadline : config_json["commandDeadlines"]) {
+			if (!deadline.is_number_unsigned()) {
+				return false;
+			}
+		}
+
+		for (auto map : config_json["maps"]) {
 			if (!validate_map_entry(map)) {
 				return false;
 			}
 		}
 
+		// a global gate id can only be routed to a single device
+		std::vector<unsigned int> gate_ids;
+		for (auto device : config_json["devices"]) {
+			if (!validate_device_entry(device)) {
+				return false;
+			}
+
+			for (auto route : device["gates"]) {
+				unsigned int gate_id = route["id"];
+				if (std::find(gate_ids.begin(), gate_ids.end(), gate_id) != gate_ids.end()) {
+					return false;
+				}
+				gate_ids.push_back(gate_id);
+			}
+		}
+
 		return true;
 	}
 
@@ -114,9 +541,13 @@ struct gc_config {
 			throw parse_error("config contents are malformed");
 		}
 
+		if (parsed_json.is_array()) {
+			parsed_json = { { "maps", parsed_json } };
+		}
+
 		std::vector<map_entry> maps;
 
-		for (auto map : parsed_json) {
+		for (auto map : parsed_json["maps"]) {
 			std::optional<std::string> group_value = std::nullopt;
 			if (map["group"].is_string()) {
 				group_value = map["group"];
@@ -127,12 +558,103 @@ struct gc_config {
 					map["id"],
 					group_value,
 					map["mapImage"],
-					map["gates"]
+					map["gates"],
+					map["scenes"].is_object() ? map["scenes"] : nlohmann::json::object()
+				)
+			);
+		}
+
+		std::vector<device_entry> devices;
+
+		for (auto device : parsed_json["devices"]) {
+			std::vector<gate_route> routes;
+			for (auto route : device["gates"]) {
+				routes.push_back({ route["id"], route["local"] });
+			}
+
+			serial_options serial;
+			if (device["baudRate"].is_number_unsigned()) {
+				serial.baud_rate = device["baudRate"];
+			}
+
+			nlohmann::json serial_json = device["serial"];
+			if (serial_json.is_object()) {
+				serial.low_latency = serial_json.value("lowLatency", serial.low_latency);
+				serial.raw = serial_json.value("raw", serial.raw);
+				serial.read_burst_size = serial_json.value("readBurstSize", serial.read_burst_size);
+			}
+
+			unsigned int progress_interval = device_entry::DEFAULT_PROGRESS_INTERVAL;
+			if (device["progressInterval"].is_number_unsigned()) {
+				progress_interval = device["progressInterval"];
+			}
+
+			unsigned int travel_time = device_entry::DEFAULT_TRAVEL_TIME;
+			if (device["travelTime"].is_number_unsigned()) {
+				travel_time = device["travelTime"];
+			}
+
+			std::optional<std::vector<unsigned int>> pins = std::nullopt;
+			if (device["pins"].is_array()) {
+				pins = device["pins"].get<std::vector<unsigned int>>();
+			}
+
+			devices.push_back(
+				device_entry(
+					device["id"],
+					device["port"],
+					serial,
+					routes,
+					pins,
+					progress_interval,
+					travel_time
 				)
 			);
 		}
 
-		return gc_config(maps);
+		gc_config config(maps, devices);
+
+		// a deadline of 0 removes the default one
+		for (auto& [type, deadline] : parsed_json["commandDeadlines"].items()) {
+			if (deadline == 0) {
+				config.command_deadlines.erase(type);
+			}
+			else {
+				config.command_deadlines[type] = std::chrono::milliseconds(deadline.get<unsigned int>());
+			}
+		}
+
+		nlohmann::json compression_json = parsed_json["compression"];
+		if (compression_json.is_object()) {
+			config.compression.min_size = compression_json.value("minSize", config.compression.min_size);
+			config.compression.level = compression_json.value("level", config.compression.level);
+		}
+
+		for (auto job : parsed_json["schedule"]) {
+			schedule_entry entry;
+			entry.id = job["id"];
+			entry.user = job["user"];
+			entry.command = job["command"];
+
+			if (job["every"].is_number_unsigned()) {
+				entry.every = job["every"];
+			}
+			else {
+				entry.at = schedule_entry::parse_time_of_day(job["at"]);
+			}
+
+			if (job["date"].is_string()) {
+				entry.date = schedule_entry::parse_date(job["date"]);
+			}
+
+			for (auto day : job["days"]) {
+				entry.weekdays |= 1u << schedule_entry::parse_weekday(day).value();
+			}
+
+			config.schedule.push_back(entry);
+		}
+
+		return config;
 	}
 
 	static std::optional<gc_config> open_from_file(fs::path file_path) {
@@ -172,7 +694,32 @@ struct gc_config {
 		return nlohmann::json(jsonified_maps).dump();
 	}
 
-	const map_entry& get_map_by_id(std::string_view id) {
+	// every gate id referenced by the maps, sorted and without duplicates
+	std::vector<unsigned int> get_gate_ids() const {
+		std::vector<unsigned int> gate_ids;
+
+		for (const map_entry& map : maps) {
+			for (const auto& gate : map.gate_config) {
+				gate_ids.push_back(gate["id"]);
+			}
+		}
+
+		std::sort(gate_ids.begin(), gate_ids.end());
+		gate_ids.erase(std::unique(gate_ids.begin(), gate_ids.end()), gate_ids.end());
+
+		return gate_ids;
+	}
+
+	std::optional<std::chrono::milliseconds> get_command_deadline(const std::string& type) const {
+		const auto found = command_deadlines.find(type);
+		if (found == command_deadlines.end()) {
+			return std::nullopt;
+		}
+
+		return found->second;
+	}
+
+	const map_entry& get_map_by_id(std::string_view id) const {
 		auto found_map = 
 			std::find_if(
 				maps.begin(), 
@@ -0,0 +1,289 @@
+#include "device_pool.hpp"
+
+device_pool::device_pool(
+	net::io_context& io,
+	const std::vector<device_entry>& entries
+) {
+	for (const device_entry& entry : entries) {
+		std::shared_ptr<arduino_messenger> messenger;
+		try {
+			messenger = std::make_shared<arduino_messenger>(io, entry.port, entry.serial);
+		}
+		catch (const arduino_messenger::open_error& error) {
+			const std::string what = "device '" + entry.id + "': " + error.what();
+			throw arduino_messenger::open_error(what.c_str());
+		}
+
+		device dev{ entry.id, messenger, {}, {}, std::chrono::milliseconds(entry.travel_time) };
+
+		std::vector<unsigned int> local_ids;
+		for (const gate_route& r : entry.routes) {
+			dev.local_to_global.insert({ r.local_id, r.gate_id });
+			dev.gate_ids.push_back(r.gate_id);
+			routes.insert({ r.gate_id, { devices.size(), r.local_id } });
+			gate_ids.push_back(r.gate_id);
+			local_ids.push_back(r.local_id);
+		}
+
+		messenger->set_gate_ids(local_ids);
+
+		nlohmann::json device_config = { { "progressInterval", entry.progress_interval } };
+		if (entry.pins) {
+			device_config["pins"] = entry.pins.value();
+		}
+		messenger->set_device_config(device_config);
+
+		devices.push_back(std::move(dev));
+	}
+
+	std::sort(gate_ids.begin(), gate_ids.end());
+}
+
+void device_pool::run() {
+	for (device& dev : devices) {
+		dev.messenger->run();
+	}
+}
+
+std::optional<json_message> device_pool::send_message(
+	json_message message,
+	MessagePriority priority,
+	const std::string& owner,
+	std::optional<arduino_messenger::clock::time_point> deadline,
+	arduino_messenger::expired_handler on_expired
+) {
+	if (message.type == json_message::ChangeState) {
+		if (!message.payload.is_object() || !message.payload["id"].is_number_unsigned()) {
+			return std::nullopt;
+		}
+
+		const auto found_route = routes.find(message.payload["id"].get<unsigned int>());
+		if (found_route == routes.end()) {
+			return std::nullopt;
+		}
+
+		// the handler gets the command as it was sent, with the global id
+		arduino_messenger::expired_handler on_local_expired = nullptr;
+		if (on_expired) {
+			on_local_expired = [on_expired, message](const json_message&) { on_expired(message); };
+		}
+
+		const route& r = found_route->second;
+		json_message local_message = message;
+		local_message.payload["id"] = r.local_id;
+		if (!devices[r.device_index].messenger->send_message(local_message, priority, owner, deadline, on_local_expired)) {
+			return message;
+		}
+
+		return std::nullopt;
+	}
+	else if (message.type == json_message::QueryState) {
+		if (!message.payload.is_array()) {
+			return std::nullopt;
+		}
+
+		// split the query into one query per device
+		std::vector<nlohmann::json> queries(devices.size(), nlohmann::json::array());
+		std::vector<nlohmann::json> global_queries(devices.size(), nlohmann::json::array());
+		for (const auto& id : message.payload) {
+			if (!id.is_number_unsigned()) {
+				continue;
+			}
+
+			const auto found_route = routes.find(id.get<unsigned int>());
+			if (found_route == routes.end()) {
+				continue;
+			}
+
+			queries[found_route->second.device_index].push_back(found_route->second.local_id);
+			global_queries[found_route->second.device_index].push_back(id);
+		}
+
+		// only the gates of the busy devices are turned away, the other parts are still sent
+		nlohmann::json rejected = nlohmann::json::array();
+		for (std::size_t i = 0; i < devices.size(); i++) {
+			if (queries[i].empty()) {
+				continue;
+			}
+
+			arduino_messenger::expired_handler on_local_expired = nullptr;
+			if (on_expired) {
+				on_local_expired = [on_expired, global_query = global_queries[i]](const json_message&) {
+					on_expired(json_message(json_message::QueryState, global_query));
+				};
+			}
+
+			const bool accepted = devices[i].messenger->send_message(
+				json_message(json_message::QueryState, queries[i]),
+				priority,
+				owner,
+				deadline,
+				on_local_expired
+			);
+
+			if (!accepted) {
+				rejected.insert(rejected.end(), global_queries[i].begin(), global_queries[i].end());
+			}
+		}
+
+		if (!rejected.empty()) {
+			return json_message(json_message::QueryState, rejected);
+		}
+
+		return std::nullopt;
+	}
+	else if (message.type == json_message::ChangeStateBatch) {
+		if (!gc_config::validate_batch(message.payload)) {
+			return std::nullopt;
+		}
+
+		// split the batch into one batch per device, so that every device
+		// gets all of it's gates in a single frame
+		const nlohmann::json empty_batch = { { "raise", nlohmann::json::array() }, { "lower", nlohmann::json::array() } };
+		std::vector<nlohmann::json> batches(devices.size(), empty_batch);
+		std::vector<nlohmann::json> global_batches(devices.size(), empty_batch);
+
+		for (const char* key : { "raise", "lower" }) {
+			for (const auto& id : message.payload.value(key, nlohmann::json::array())) {
+				const auto found_route = routes.find(id.get<unsigned int>());
+				if (found_route == routes.end()) {
+					continue;
+				}
+
+				batches[found_route->second.device_index][key].push_back(found_route->second.local_id);
+				global_batches[found_route->second.device_index][key].push_back(id);
+			}
+		}
+
+		// only the gates of the busy devices are turned away, the other parts are still sent
+		nlohmann::json rejected = empty_batch;
+		bool any_rejected = false;
+		for (std::size_t i = 0; i < devices.size(); i++) {
+			if (batches[i]["raise"].empty() && batches[i]["lower"].empty()) {
+				continue;
+			}
+
+			arduino_messenger::expired_handler on_local_expired = nullptr;
+			if (on_expired) {
+				on_local_expired = [on_expired, global_batch = global_batches[i]](const json_message&) {
+					on_expired(json_message(json_message::ChangeStateBatch, global_batch));
+				};
+			}
+
+			const bool accepted = devices[i].messenger->send_message(
+				json_message(json_message::ChangeStateBatch, batches[i]),
+				priority,
+				owner,
+				deadline,
+				on_local_expired
+			);
+
+			if (!accepted) {
+				for (const char* key : { "raise", "lower" }) {
+					rejected[key].insert(rejected[key].end(), global_batches[i][key].begin(), global_batches[i][key].end());
+				}
+				any_rejected = true;
+			}
+		}
+
+		if (any_rejected) {
+			return json_message(json_message::ChangeStateBatch, rejected);
+		}
+
+		return std::nullopt;
+	}
+
+	return std::nullopt;
+}
+
+void device_pool::set_message_handler(arduino_messenger::message_handler handler) {
+	for (device& dev : devices) {
+		dev.messenger->set_message_handler(handler);
+	}
+}
+
+std::optional<json_message> device_pool::pop_message() {
+	std::lock_guard lock(read_mutex);
+
+	for (std::size_t i = 0; i < devices.size(); i++) {
+		const device& dev = devices[(next_device + i) % devices.size()];
+
+		if (auto message = dev.messenger->pop_message()) {
+			next_device = (next_device + i + 1) % devices.size();
+			return to_global(dev, std::move(message.value()));
+		}
+	}
+
+	return std::nullopt;
+}
+
+const std::vector<unsigned int>& device_pool::get_gate_ids() const {
+	return gate_ids;
+}
+
+std::vector<unsigned int> device_pool::get_gate_ids_below_depth(std::size_t max_depth) {
+	std::vector<unsigned int> ids;
+
+	for (device& dev : devices) {
+		if (dev.messenger->get_outgoing_depth() <= max_depth) {
+			ids.insert(ids.end(), dev.gate_ids.begin(), dev.gate_ids.end());
+		}
+	}
+
+	std::sort(ids.begin(), ids.end());
+	return ids;
+}
+
+std::chrono::milliseconds device_pool::get_travel_time(unsigned int gate_id) const {
+	const auto found_route = routes.find(gate_id);
+	if (found_route == routes.end()) {
+		return std::chrono::milliseconds(device_entry::DEFAULT_TRAVEL_TIME);
+	}
+
+	return devices[found_route->second.device_index].travel_time;
+}
+
+std::map<std::string, link_telemetry::snapshot> device_pool::get_telemetry() {
+	std::map<std::string, link_telemetry::snapshot> result;
+
+	for (device& dev : devices) {
+		result.insert({ dev.id, dev.messenger->get_telemetry() });
+	}
+
+	return result;
+}
+
+json_message device_pool::to_global(const device& dev, json_message message) const {
+	// tell the clients which gates became (un)available
+	if (message.type == json_message::Availability) {
+		message.payload["device"] = dev.id;
+		message.payload["gates"] = dev.gate_ids;
+		return message;
+	}
+
+	if (
+		(message.type != json_message::QueryStateResult && message.type != json_message::Progress) ||
+		!message.payload.is_array()
+	) {
+		return message;
+	}
+
+	nlohmann::json translated = nlohmann::json::array();
+	for (auto& gate : message.payload) {
+		if (!gate.is_object() || !gate["id"].is_number_unsigned()) {
+			continue;
+		}
+
+		// drop the gates that aren't routed anywhere
+		const auto found_id = dev.local_to_global.find(gate["id"].get<unsigned int>());
+		if (found_id == dev.local_to_global.end()) {
+			continue;
+		}
+
+		gate["id"] = found_id->second;
+		translated.push_back(gate);
+	}
+
+	message.payload = translated;
+	return message;
+}
@@ -0,0 +1,91 @@
+#ifndef DEVICE_POOL_HPP
+#define DEVICE_POOL_HPP
+
+#include "common.hpp"
+
+#include <memory>
+#include <vector>
+#include <unordered_map>
+#include <map>
+#include <optional>
+#include <mutex>
+#include <chrono>
+
+#include <boost/asio/io_context.hpp>
+
+#include "arduino_messenger.hpp"
+#include "json_message.hpp"
+#include "config.hpp"
+
+// a set of Arduino controllers, each on it's own serial port,
+// that are addressed with global gate ids
+class device_pool : public std::enable_shared_from_this<device_pool> {
+	struct device {
+		std::string id;
+		std::shared_ptr<arduino_messenger> messenger;
+		std::unordered_map<unsigned int, unsigned int> local_to_global;
+		std::vector<unsigned int> gate_ids;
+		std::chrono::milliseconds travel_time;
+	};
+
+	struct route {
+		std::size_t device_index;
+		unsigned int local_id;
+	};
+
+	std::vector<device> devices;
+	std::unordered_map<unsigned int, route> routes;
+	std::vector<unsigned int> gate_ids;
+
+	// the device to read from first on the next pop_message call,
+	// so that a chatty device doesn't starve the others
+	std::size_t next_device = 0;
+	std::mutex read_mutex;
+
+public:
+	device_pool(
+		net::io_context& io,
+		const std::vector<device_entry>& entries
+	);
+
+	void run();
+
+	// translates global gate ids in the message to local ones
+	// and sends it to the devices the gates are connected to,
+	// returns the parts of it the busy devices turned away, with global ids,
+	// the parts of it dropped for missing the deadline are passed to on_expired with global ids
+	std::optional<json_message> send_message(
+		json_message message,
+		MessagePriority priority = Routine,
+		const std::string& owner = "",
+		std::optional<arduino_messenger::clock::time_point> deadline = std::nullopt,
+		arduino_messenger::expired_handler on_expired = nullptr
+	);
+
+	// sets the function to call whenever one of the devices received a message,
+	// it must not call back into the pool
+	void set_message_handler(arduino_messenger::message_handler handler);
+
+	// takes the oldest received message from one of the devices,
+	// with gate ids translated back to global ones
+	std::optional<json_message> pop_message();
+
+	// all routed global gate ids, sorted
+	const std::vector<unsigned int>& get_gate_ids() const;
+
+	// the global gate ids of the devices with at most max_depth messages waiting to be written,
+	// so that the server's own queries don't pile up on a busy link
+	std::vector<unsigned int> get_gate_ids_below_depth(std::size_t max_depth);
+
+	// how long the gate takes to fully raise or lower
+	std::chrono::milliseconds get_travel_time(unsigned int gate_id) const;
+
+	// the link counters of every device by it's id,
+	// with the rates and queue peaks since the previous call
+	std::map<std::string, link_telemetry::snapshot> get_telemetry();
+
+private:
+	json_message to_global(const device& dev, json_message message) const;
+};
+
+#endif
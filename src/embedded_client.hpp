@@ -0,0 +1,21 @@
+#ifndef EMBEDDED_CLIENT_HPP
+#define EMBEDDED_CLIENT_HPP
+
+#include <string_view>
+#include <span>
+
+// a file of the client web app, compiled into the server by cmake/embed_client.cmake
+struct embedded_asset {
+    std::string_view path;
+    std::string_view body;
+    // the path has a hash of the content in it, so what it refers to never changes
+    bool is_immutable;
+};
+
+// every embedded file, the ones the pages refer to by a hashed path are listed under both paths
+std::span<const embedded_asset> get_embedded_assets();
+
+// the index of the asset at the path in get_embedded_assets(), the count of the assets if there's none
+std::size_t find_embedded_asset(std::string_view path);
+
+#endif
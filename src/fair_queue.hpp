@@ -0,0 +1,65 @@
+#ifndef FAIR_QUEUE_HPP
+#define FAIR_QUEUE_HPP
+
+#include <string>
+#include <deque>
+#include <unordered_map>
+#include <cstddef>
+
+// a queue made of a sub-queue per owner, which are taken from round-robin,
+// so that an owner with a large backlog doesn't make everyone else wait behind it
+template <class T>
+class fair_queue {
+	// the owners with queued items, the one at the front is taken from next
+	std::deque<std::string> rotation;
+	std::unordered_map<std::string, std::deque<T>> queues;
+	std::size_t total_size = 0;
+
+public:
+	void push_back(const std::string& owner, T item) {
+		auto& queue = queues[owner];
+		if (queue.empty()) {
+			rotation.push_back(owner);
+		}
+
+		queue.push_back(std::move(item));
+		total_size++;
+	}
+
+	// expects the queue not to be empty
+	T& front() {
+		return queues.at(rotation.front()).front();
+	}
+
+	// takes the front item, and moves it's owner to the end of the rotation
+	void pop_front() {
+		const std::string owner = rotation.front();
+		rotation.pop_front();
+
+		auto& queue = queues.at(owner);
+		queue.pop_front();
+		total_size--;
+
+		if (queue.empty()) {
+			queues.erase(owner);
+		}
+		else {
+			rotation.push_back(owner);
+		}
+	}
+
+	bool empty() const {
+		return total_size == 0;
+	}
+
+	std::size_t size() const {
+		return total_size;
+	}
+
+	std::size_t size(const std::string& owner) const {
+		const auto found = queues.find(owner);
+		return found == queues.end() ? 0 : found->second.size();
+	}
+};
+
+#endif
@@ -0,0 +1,94 @@
+#include "file_range.hpp"
+
+#include <charconv>
+#include <sstream>
+#include <optional>
+
+static std::optional<std::uint64_t> parse_position(std::string_view str) {
+    std::uint64_t value = 0;
+    const auto result = std::from_chars(str.data(), str.data() + str.size(), value);
+    if (str.empty() || result.ec != std::errc() || result.ptr != str.data() + str.size()) {
+        return std::nullopt;
+    }
+
+    return value;
+}
+
+RangeResult parse_range(std::string_view field, std::uint64_t size, byte_range& range) {
+    if (!field.starts_with("bytes=")) {
+        return WholeFile;
+    }
+    field.remove_prefix(6);
+
+    // a list of ranges would need a multipart response, the whole file is sent instead
+    if (field.find(',') != std::string_view::npos) {
+        return WholeFile;
+    }
+
+    const auto start = field.find_first_not_of(" \t");
+    if (start == std::string_view::npos) {
+        return WholeFile;
+    }
+    field = field.substr(start, field.find_last_not_of(" \t") - start + 1);
+
+    const auto dash = field.find('-');
+    if (dash == std::string_view::npos) {
+        return WholeFile;
+    }
+
+    const std::string_view first = field.substr(0, dash);
+    const std::string_view last = field.substr(dash + 1);
+
+    // "-n" asks for the last n bytes
+    if (first.empty()) {
+        const auto suffix_length = parse_position(last);
+        if (!suffix_length) {
+            return WholeFile;
+        }
+
+        if (suffix_length.value() == 0 || size == 0) {
+            return UnsatisfiableRange;
+        }
+
+        range.first = size - std::min(suffix_length.value(), size);
+        range.last = size - 1;
+        return PartialFile;
+    }
+
+    const auto first_position = parse_position(first);
+    if (!first_position) {
+        return WholeFile;
+    }
+
+    // "n-" asks for everything from n
+    std::uint64_t last_position = size - 1;
+    if (!last.empty()) {
+        const auto parsed_last = parse_position(last);
+        if (!parsed_last || parsed_last.value() < first_position.value()) {
+            return WholeFile;
+        }
+        last_position = std::min(parsed_last.value(), size - 1);
+    }
+
+    if (first_position.value() >= size) {
+        return UnsatisfiableRange;
+    }
+
+    range.first = first_position.value();
+    range.last = last_position;
+    return PartialFile;
+}
+
+std::string make_file_etag(const fs::path& path, std::uint64_t size) {
+    std::error_code ec;
+    const auto modified_time = fs::last_write_time(path, ec);
+
+    std::ostringstream etag;
+    etag << '"' << std::hex << size << '-';
+    if (!ec) {
+        etag << modified_time.time_since_epoch().count();
+    }
+    etag << '"';
+
+    return etag.str();
+}
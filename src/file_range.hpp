@@ -0,0 +1,42 @@
+#ifndef FILE_RANGE_HPP
+#define FILE_RANGE_HPP
+
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include <filesystem>
+
+#include "common.hpp"
+
+#include <boost/beast/core/file.hpp>
+
+namespace fs = std::filesystem;
+
+// a part of an open file to send as a response body
+struct file_range {
+    beast::file file;
+    std::uint64_t offset = 0;
+    std::uint64_t length = 0;
+};
+
+// the first and the last byte of a range, inclusive
+struct byte_range {
+    std::uint64_t first;
+    std::uint64_t last;
+};
+
+enum RangeResult {
+    // the Range field is missing, malformed or asks for several ranges
+    WholeFile,
+    PartialFile,
+    UnsatisfiableRange
+};
+
+// interprets a Range field value for a file of the size,
+// sets the range if the result is PartialFile
+RangeResult parse_range(std::string_view field, std::uint64_t size, byte_range& range);
+
+// an entity tag made from the size and the modification time of the file
+std::string make_file_etag(const fs::path& path, std::uint64_t size);
+
+#endif
@@ -0,0 +1,577 @@
+// Simulates the gate_control.ino firmware on a pseudo-terminal,
+// so that the server can be run and load-tested without an Arduino.
+
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <deque>
+#include <chrono>
+#include <random>
+#include <optional>
+#include <algorithm>
+#include <cstring>
+#include <csignal>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <nlohmann/json.hpp>
+
+// the gate logic and the message framing are shared with the firmware
+#include "gate.h"
+#include "frame_reader.h"
+
+using namespace std::chrono_literals;
+using sim_clock = std::chrono::steady_clock;
+
+// the protocol strings, as in gate_control.ino
+const char* TYPE = "type";
+const char* PAYLOAD = "payload";
+const char* CHANGE_STATE = "change_state";
+const char* CHANGE_STATE_BATCH = "change_state_batch";
+const char* QUERY_STATE = "query_state";
+const char* QUERY_STATE_RESULT = "query_state_result";
+const char* FINISHED = "finished";
+const char* CONFIG = "config";
+const char* PROGRESS = "progress";
+
+const char* ERROR_MESSAGE_START = "{\"type\": \"error\", \"payload\": \"";
+const char* ERROR_MESSAGE_END = "\"}";
+
+const char* STATE_RAISED = "raised";
+const char* STATE_RAISING = "raising";
+const char* STATE_LOWERED = "lowered";
+const char* STATE_LOWERING = "lowering";
+
+const unsigned int DEFAULT_GATE_COUNT = 7;
+const unsigned int MAX_GATES = 32;
+const unsigned long MIN_PROGRESS_INTERVAL = 20;
+
+struct options {
+	unsigned int gate_count = DEFAULT_GATE_COUNT;
+	std::chrono::milliseconds latency{ 0 };
+	std::chrono::milliseconds jitter{ 0 };
+	// 0 means the messages are written in one piece
+	std::size_t fragment_size = 0;
+	std::chrono::milliseconds fragment_gap{ 1 };
+	// 0 means the link isn't throttled
+	unsigned int baud_rate = 0;
+	std::optional<std::string> link_path;
+};
+
+const char* state_to_str(GateState state) {
+	if (state == Raised)    return STATE_RAISED;
+	if (state == Raising)   return STATE_RAISING;
+	if (state == Lowered)   return STATE_LOWERED;
+	return STATE_LOWERING;
+}
+
+class simulator {
+	struct pending_write {
+		sim_clock::time_point due;
+		std::string data;
+	};
+
+	const options opts;
+	int master_fd;
+	std::vector<Gate> gates;
+	// the origin of the simulated millis()
+	const sim_clock::time_point start_time = sim_clock::now();
+
+	// 0 disables the progress messages
+	unsigned long progress_interval = 0;
+	unsigned long last_progress = 0;
+
+	FrameReader reader;
+	std::deque<pending_write> output;
+	sim_clock::time_point last_due = sim_clock::now();
+	// the pty buffer was full when the front of the output was written
+	bool output_blocked = false;
+
+	std::mt19937 rng{ std::random_device{}() };
+
+public:
+	simulator(const options& opts, int master_fd)
+		: opts(opts), master_fd(master_fd), gates(opts.gate_count) {}
+
+	// one pass of the firmware's loop()
+	void loop() {
+		read_input();
+		update_gates();
+		send_progress();
+		flush_output();
+	}
+
+	// how long the loop can sleep while waiting for input
+	int poll_timeout_ms() const {
+		const bool moving = std::any_of(
+			gates.begin(),
+			gates.end(),
+			[](const Gate& g) { return g.get_state() == Raising || g.get_state() == Lowering; }
+		);
+
+		// the firmware loop never sleeps, but a millisecond is the resolution of millis()
+		if (moving) {
+			return 1;
+		}
+
+		// the loop is woken up by the pty becoming writable instead
+		if (!output.empty() && !output_blocked) {
+			const auto until_due = output.front().due - sim_clock::now();
+			return static_cast<int>(
+				std::max<long long>(
+					0,
+					std::chrono::duration_cast<std::chrono::milliseconds>(until_due).count()
+				)
+			);
+		}
+
+		return -1;
+	}
+
+	bool is_output_blocked() const {
+		return output_blocked;
+	}
+
+private:
+	void read_input() {
+		char buffer[1024];
+		ssize_t bytes_read;
+
+		while ((bytes_read = read(master_fd, buffer, sizeof(buffer))) > 0) {
+			for (ssize_t i = 0; i < bytes_read; i++) {
+				reader.push(buffer[i]);
+
+				// like the firmware, every message is handled as soon as it's complete
+				if (reader.take_overflow()) {
+					send_error("message_too_long");
+				}
+
+				while (reader.has_frame()) {
+					std::string frame;
+					for (int c = reader.read(); c >= 0; c = reader.read()) {
+						frame += static_cast<char>(c);
+					}
+					reader.finish_frame();
+
+					handle_message(frame);
+				}
+			}
+		}
+	}
+
+	void handle_message(const std::string& frame) {
+		const nlohmann::json doc = nlohmann::json::parse(frame, nullptr, false);
+
+		// the firmware skips documents it couldn't deserialize
+		if (doc.is_discarded() || doc.is_null()) {
+			return;
+		}
+
+		if (!doc.is_object() || !doc.contains(TYPE) || !doc[TYPE].is_string()) {
+			send_error("malformed_type");
+			return;
+		}
+		const std::string type = doc[TYPE];
+		const nlohmann::json payload = doc.value(PAYLOAD, nlohmann::json());
+
+		if (type == CHANGE_STATE) {
+			if (
+				!payload.is_object() ||
+				!payload.contains("id") || !payload["id"].is_number_unsigned() ||
+				!payload.contains("state") || !payload["state"].is_boolean()
+			) {
+				send_error("malformed_change_state_payload");
+				return;
+			}
+
+			const unsigned int id = payload["id"];
+			if (id >= gates.size()) {
+				send_error("unknown_gate");
+				return;
+			}
+
+			if (payload["state"].get<bool>()) {
+				gates[id].raise(millis());
+			}
+			else {
+				gates[id].lower(millis());
+			}
+
+			send_gate_states({ id });
+		}
+		else if (type == CHANGE_STATE_BATCH) {
+			if (!payload.is_object()) {
+				send_error("malformed_change_state_batch_payload");
+				return;
+			}
+
+			// check the whole batch first, so that it's either applied entirely or not at all
+			std::vector<unsigned int> ids;
+			std::size_t raise_count = 0;
+			for (const char* key : { "raise", "lower" }) {
+				const nlohmann::json list = payload.value(key, nlohmann::json());
+				if (list.is_null()) {
+					continue;
+				}
+				if (!list.is_array()) {
+					send_error("malformed_change_state_batch_payload");
+					return;
+				}
+
+				for (const auto& el : list) {
+					if (!el.is_number_unsigned()) {
+						send_error("malformed_change_state_batch_payload");
+						return;
+					}
+					if (el.get<unsigned int>() >= gates.size()) {
+						send_error("unknown_gate");
+						return;
+					}
+					if (ids.size() >= MAX_GATES) {
+						send_error("too_many_gates");
+						return;
+					}
+					ids.push_back(el);
+				}
+
+				if (std::string_view(key) == "raise") {
+					raise_count = ids.size();
+				}
+			}
+
+			// all the gates start moving at the same time
+			const unsigned long now = millis();
+			for (std::size_t i = 0; i < ids.size(); i++) {
+				if (i < raise_count) {
+					gates[ids[i]].raise(now);
+				}
+				else {
+					gates[ids[i]].lower(now);
+				}
+			}
+
+			send_gate_states(ids);
+		}
+		else if (type == QUERY_STATE) {
+			if (!payload.is_array()) {
+				send_error("malformed_query_state_payload");
+				return;
+			}
+
+			std::vector<unsigned int> ids;
+			for (const auto& el : payload) {
+				if (el.is_number_unsigned()) {
+					ids.push_back(el);
+				}
+			}
+
+			send_gate_states(ids);
+		}
+		else if (type == CONFIG) {
+			if (!payload.is_object()) {
+				send_error("malformed_config_payload");
+				return;
+			}
+
+			// every setting is optional
+			if (payload.contains("progressInterval")) {
+				if (!payload["progressInterval"].is_number_unsigned()) {
+					send_error("malformed_config_payload");
+					return;
+				}
+
+				progress_interval = payload["progressInterval"];
+				if (progress_interval != 0 && progress_interval < MIN_PROGRESS_INTERVAL) {
+					progress_interval = MIN_PROGRESS_INTERVAL;
+				}
+			}
+
+			if (payload.contains("pins")) {
+				if (!payload["pins"].is_array()) {
+					send_error("malformed_config_payload");
+					return;
+				}
+
+				if (payload["pins"].size() > MAX_GATES) {
+					send_error("too_many_gates");
+					return;
+				}
+
+				if (
+					!std::all_of(
+						payload["pins"].begin(),
+						payload["pins"].end(),
+						[](const nlohmann::json& pin) { return pin.is_number_unsigned() && pin <= 255; }
+					)
+				) {
+					send_error("malformed_config_payload");
+					return;
+				}
+
+				// there are no pins to drive, only the gate count matters,
+				// and the gates that stay keep their state (assuming their pin didn't change)
+				gates.resize(payload["pins"].size());
+			}
+		}
+		else {
+			send_error();
+		}
+	}
+
+	unsigned long millis() const {
+		return static_cast<unsigned long>(
+			std::chrono::duration_cast<std::chrono::milliseconds>(sim_clock::now() - start_time).count()
+		);
+	}
+
+	void update_gates() {
+		const unsigned long now = millis();
+
+		// the gates that finished moving together are reported together
+		std::vector<unsigned int> finished;
+
+		for (unsigned int i = 0; i < gates.size(); i++) {
+			gates[i].tick(now);
+
+			if (gates[i].finished_moving()) {
+				finished.push_back(i);
+			}
+		}
+
+		if (!finished.empty()) {
+			send_gate_states(finished, FINISHED);
+		}
+	}
+
+	void send_progress() {
+		const unsigned long now = millis();
+		if (progress_interval == 0 || now - last_progress < progress_interval) {
+			return;
+		}
+
+		std::string message = std::string("{\"") + TYPE + "\":\"" + PROGRESS + "\",\"" + PAYLOAD + "\":[";
+
+		bool first = true;
+		for (unsigned int id = 0; id < gates.size(); id++) {
+			const GateState state = gates[id].get_state();
+			if (state != Raising && state != Lowering) {
+				continue;
+			}
+
+			if (!first) {
+				message += ',';
+			}
+			first = false;
+
+			const auto position = static_cast<unsigned int>(gates[id].state * 100 + 0.5F);
+			message += "{\"id\":" + std::to_string(id) + ",\"position\":" + std::to_string(position) + "}";
+		}
+
+		if (first) {
+			return;
+		}
+
+		message += "]}";
+		send(message);
+		last_progress = now;
+	}
+
+	void send_gate_states(const std::vector<unsigned int>& ids, const char* type = QUERY_STATE_RESULT) {
+		// serialized by hand to keep the key order and formatting of ArduinoJson
+		std::string message = std::string("{\"") + TYPE + "\":\"" + type + "\",\"" + PAYLOAD + "\":[";
+
+		bool first = true;
+		for (unsigned int id : ids) {
+			if (id >= gates.size()) {
+				continue;
+			}
+
+			if (!first) {
+				message += ',';
+			}
+			first = false;
+
+			message += "{\"id\":" + std::to_string(id) + ",\"state\":\"" + state_to_str(gates[id].get_state()) + "\"}";
+		}
+
+		message += "]}";
+		send(message);
+	}
+
+	void send_error(std::string_view payload = "unknown") {
+		send(ERROR_MESSAGE_START + std::string(payload) + ERROR_MESSAGE_END);
+	}
+
+	// schedules the message for writing after the configured latency,
+	// never reordering it with the previous ones
+	void send(const std::string& message) {
+		auto delay = std::chrono::duration_cast<sim_clock::duration>(opts.latency);
+		if (opts.jitter.count() > 0) {
+			std::uniform_int_distribution<long long> distribution(0, opts.jitter.count());
+			delay += std::chrono::milliseconds(distribution(rng));
+		}
+
+		const std::size_t fragment_size = opts.fragment_size == 0 ? message.size() : opts.fragment_size;
+
+		sim_clock::time_point due = std::max(sim_clock::now() + delay, last_due);
+		for (std::size_t pos = 0; pos < message.size(); pos += fragment_size) {
+			std::string fragment = message.substr(pos, fragment_size);
+			const auto transmission_time = this->transmission_time(fragment.size());
+
+			output.push_back({ due, std::move(fragment) });
+			due += transmission_time + opts.fragment_gap;
+		}
+
+		last_due = due;
+	}
+
+	// the time a real serial link would take to transmit the bytes (8N1 framing)
+	sim_clock::duration transmission_time(std::size_t bytes) const {
+		if (opts.baud_rate == 0) {
+			return sim_clock::duration::zero();
+		}
+
+		return std::chrono::microseconds(bytes * 10 * 1000000 / opts.baud_rate);
+	}
+
+	void flush_output() {
+		const auto now = sim_clock::now();
+
+		output_blocked = false;
+
+		while (!output.empty() && output.front().due <= now) {
+			std::string& data = output.front().data;
+
+			std::size_t written = 0;
+			while (written < data.size()) {
+				const ssize_t result = write(master_fd, data.data() + written, data.size() - written);
+				if (result < 0) {
+					// the server isn't reading and the pty buffer is full,
+					// keep the rest for when it's writable again, like the firmware's blocking Serial.write
+					if (errno == EAGAIN) {
+						data.erase(0, written);
+						output_blocked = true;
+					}
+					return;
+				}
+				written += result;
+			}
+
+			output.pop_front();
+		}
+	}
+};
+
+volatile std::sig_atomic_t should_stop = 0;
+
+void print_usage(const char* program) {
+	std::cout
+		<< "Usage: " << program << " [options]" << std::endl
+		<< "Options:" << std::endl
+		<< "  --gates <count>          number of simulated gates, at most " << MAX_GATES << " (default " << DEFAULT_GATE_COUNT << ")" << std::endl
+		<< "  --latency <ms>           delay before every message is sent" << std::endl
+		<< "  --jitter <ms>            maximum random delay added to the latency" << std::endl
+		<< "  --fragment <bytes>       split sent messages into fragments of at most that size" << std::endl
+		<< "  --fragment-gap <ms>      delay between the fragments (default 1)" << std::endl
+		<< "  --baud <rate>            throttle sent data to the given baud rate" << std::endl
+		<< "  --link <path>            create a symlink to the pseudo-terminal at the path" << std::endl;
+}
+
+std::optional<options> parse_options(int argc, char* argv[]) {
+	options opts;
+
+	for (int i = 1; i < argc; i++) {
+		const std::string_view arg = argv[i];
+		if (i + 1 >= argc) {
+			return std::nullopt;
+		}
+		const std::string value = argv[++i];
+
+		try {
+			if (arg == "--gates")               opts.gate_count = std::stoul(value);
+			else if (arg == "--latency")        opts.latency = std::chrono::milliseconds(std::stoul(value));
+			else if (arg == "--jitter")         opts.jitter = std::chrono::milliseconds(std::stoul(value));
+			else if (arg == "--fragment")       opts.fragment_size = std::stoul(value);
+			else if (arg == "--fragment-gap")   opts.fragment_gap = std::chrono::milliseconds(std::stoul(value));
+			else if (arg == "--baud")           opts.baud_rate = std::stoul(value);
+			else if (arg == "--link")           opts.link_path = value;
+			else return std::nullopt;
+		}
+		catch (...) {
+			return std::nullopt;
+		}
+	}
+
+	// the firmware can't drive more gates than that
+	if (opts.gate_count > MAX_GATES) {
+		return std::nullopt;
+	}
+
+	return opts;
+}
+
+int main(int argc, char* argv[]) {
+	const auto opts = parse_options(argc, argv);
+	if (!opts) {
+		print_usage(argv[0]);
+		return 1;
+	}
+
+	const int master_fd = posix_openpt(O_RDWR | O_NOCTTY);
+	if (master_fd < 0 || grantpt(master_fd) != 0 || unlockpt(master_fd) != 0) {
+		std::cerr << "Couldn't open a pseudo-terminal: " << std::strerror(errno) << std::endl;
+		return 1;
+	}
+
+	const std::string slave_path = ptsname(master_fd);
+
+	// keep the slave side open, so that the master doesn't get errors
+	// while the server isn't connected, and make it raw like a real serial port
+	const int slave_fd = open(slave_path.c_str(), O_RDWR | O_NOCTTY);
+	termios tio{};
+	if (slave_fd < 0 || tcgetattr(slave_fd, &tio) != 0) {
+		std::cerr << "Couldn't open the pseudo-terminal's slave side: " << std::strerror(errno) << std::endl;
+		return 1;
+	}
+	cfmakeraw(&tio);
+	tcsetattr(slave_fd, TCSANOW, &tio);
+
+	fcntl(master_fd, F_SETFL, fcntl(master_fd, F_GETFL) | O_NONBLOCK);
+
+	if (opts->link_path) {
+		unlink(opts->link_path->c_str());
+		if (symlink(slave_path.c_str(), opts->link_path->c_str()) != 0) {
+			std::cerr << "Couldn't create a symlink to the pseudo-terminal: " << std::strerror(errno) << std::endl;
+			return 1;
+		}
+	}
+
+	std::signal(SIGINT, [](int) { should_stop = 1; });
+	std::signal(SIGTERM, [](int) { should_stop = 1; });
+
+	std::cout
+		<< "Simulating " << opts->gate_count << " gates on "
+		<< opts->link_path.value_or(slave_path) << "." << std::endl;
+
+	simulator sim(opts.value(), master_fd);
+
+	while (!should_stop) {
+		pollfd pfd{ master_fd, static_cast<short>(sim.is_output_blocked() ? POLLIN | POLLOUT : POLLIN), 0 };
+		poll(&pfd, 1, sim.poll_timeout_ms());
+
+		sim.loop();
+	}
+
+	if (opts->link_path) {
+		unlink(opts->link_path->c_str());
+	}
+
+	close(slave_fd);
+	close(master_fd);
+
+	return 0;
+}
@@ -0,0 +1,134 @@
+#include "gate_state_table.hpp"
+
+#include <algorithm>
+
+std::optional<gate_state_table::gate_state> gate_state_table::str_to_state(std::string_view str) {
+	if (str == "raised")	return Raised;
+	if (str == "raising")	return Raising;
+	if (str == "lowered")	return Lowered;
+	if (str == "lowering")	return Lowering;
+	return std::nullopt;
+}
+
+const char* gate_state_table::state_to_str(gate_state state) {
+	if (state == Raised)	return "raised";
+	if (state == Raising)	return "raising";
+	if (state == Lowered)	return "lowered";
+	return "lowering";
+}
+
+gate_state_table::gate_state_table(std::vector<unsigned int> ids) : gate_ids(std::move(ids)) {
+	std::sort(gate_ids.begin(), gate_ids.end());
+	gate_ids.erase(std::unique(gate_ids.begin(), gate_ids.end()), gate_ids.end());
+
+	// four states or eight known bits per byte
+	states.resize((gate_ids.size() + 3) / 4, 0);
+	known.resize((gate_ids.size() + 7) / 8, 0);
+}
+
+bool gate_state_table::update(const nlohmann::json& results) {
+	if (!results.is_array()) {
+		return false;
+	}
+
+	bool changed = false;
+
+	for (const auto& result : results) {
+		// operator[] of a const json requires the key to exist
+		if (
+			!result.is_object() ||
+			!result.contains("id") || !result.at("id").is_number_unsigned() ||
+			!result.contains("state") || !result.at("state").is_string()
+		) {
+			continue;
+		}
+
+		const auto index = find_index(result.at("id").get<unsigned int>());
+		const auto state = str_to_state(result.at("state").get_ref<const std::string&>());
+		if (!index || !state) {
+			continue;
+		}
+
+		if (!is_known_at(index.value()) || get_at(index.value()) != state.value()) {
+			set_at(index.value(), state.value());
+			set_known_at(index.value(), true);
+			changed = true;
+		}
+	}
+
+	return changed;
+}
+
+void gate_state_table::forget(const std::vector<unsigned int>& ids) {
+	for (unsigned int id : ids) {
+		if (const auto index = find_index(id)) {
+			set_known_at(index.value(), false);
+		}
+	}
+}
+
+std::optional<gate_state_table::gate_state> gate_state_table::get(unsigned int gate_id) const {
+	const auto index = find_index(gate_id);
+	if (!index || !is_known_at(index.value())) {
+		return std::nullopt;
+	}
+
+	return get_at(index.value());
+}
+
+nlohmann::json gate_state_table::to_json() const {
+	nlohmann::json results = nlohmann::json::array();
+
+	for (std::size_t i = 0; i < gate_ids.size(); i++) {
+		if (is_known_at(i)) {
+			results.push_back({ { "id", gate_ids[i] }, { "state", state_to_str(get_at(i)) } });
+		}
+	}
+
+	return results;
+}
+
+std::vector<unsigned int> gate_state_table::get_unknown_ids() const {
+	std::vector<unsigned int> ids;
+
+	for (std::size_t i = 0; i < gate_ids.size(); i++) {
+		if (!is_known_at(i)) {
+			ids.push_back(gate_ids[i]);
+		}
+	}
+
+	return ids;
+}
+
+std::optional<std::size_t> gate_state_table::find_index(unsigned int gate_id) const {
+	const auto found = std::lower_bound(gate_ids.begin(), gate_ids.end(), gate_id);
+	if (found == gate_ids.end() || *found != gate_id) {
+		return std::nullopt;
+	}
+
+	return found - gate_ids.begin();
+}
+
+gate_state_table::gate_state gate_state_table::get_at(std::size_t index) const {
+	return static_cast<gate_state>((states[index / 4] >> (index % 4 * 2)) & 0b11);
+}
+
+void gate_state_table::set_at(std::size_t index, gate_state state) {
+	const unsigned int shift = index % 4 * 2;
+	states[index / 4] = static_cast<std::uint8_t>(
+		(states[index / 4] & ~(0b11 << shift)) | (state << shift)
+	);
+}
+
+bool gate_state_table::is_known_at(std::size_t index) const {
+	return (known[index / 8] >> (index % 8)) & 1;
+}
+
+void gate_state_table::set_known_at(std::size_t index, bool is_known) {
+	if (is_known) {
+		known[index / 8] |= static_cast<std::uint8_t>(1 << (index % 8));
+	}
+	else {
+		known[index / 8] &= static_cast<std::uint8_t>(~(1 << (index % 8)));
+	}
+}
@@ -0,0 +1,57 @@
+#ifndef GATE_STATE_TABLE_HPP
+#define GATE_STATE_TABLE_HPP
+
+#include <vector>
+#include <optional>
+#include <string_view>
+#include <cstdint>
+#include <cstddef>
+
+#include <nlohmann/json.hpp>
+
+// the last reported state of every configured gate,
+// packed into two bits per gate (plus a bit telling if the state is known at all)
+class gate_state_table {
+public:
+	enum gate_state : std::uint8_t {
+		Raised,
+		Raising,
+		Lowered,
+		Lowering
+	};
+
+	static std::optional<gate_state> str_to_state(std::string_view str);
+	static const char* state_to_str(gate_state state);
+
+	explicit gate_state_table(std::vector<unsigned int> gate_ids);
+
+	// stores the states from a query_state_result payload,
+	// returns true if any of them changed
+	bool update(const nlohmann::json& results);
+
+	// forgets the states of the given gates, e.g. when their device is unavailable
+	void forget(const std::vector<unsigned int>& ids);
+
+	std::optional<gate_state> get(unsigned int gate_id) const;
+
+	// the known states as a query_state_result payload
+	nlohmann::json to_json() const;
+
+	// the gates without a known state
+	std::vector<unsigned int> get_unknown_ids() const;
+
+private:
+	// sorted, the position of an id is it's index in the table
+	std::vector<unsigned int> gate_ids;
+	std::vector<std::uint8_t> states;
+	std::vector<std::uint8_t> known;
+
+	std::optional<std::size_t> find_index(unsigned int gate_id) const;
+
+	gate_state get_at(std::size_t index) const;
+	void set_at(std::size_t index, gate_state state);
+	bool is_known_at(std::size_t index) const;
+	void set_known_at(std::size_t index, bool is_known);
+};
+
+#endif
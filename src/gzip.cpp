@@ -0,0 +1,124 @@
+#include "gzip.hpp"
+
+#include <array>
+#include <algorithm>
+#include <cctype>
+#include <optional>
+#include <stdexcept>
+
+#include <boost/beast/zlib/deflate_stream.hpp>
+#include <boost/beast/zlib/error.hpp>
+
+#include "common.hpp"
+
+static constexpr std::array<std::uint32_t, 256> make_crc32_table() {
+    std::array<std::uint32_t, 256> table{};
+
+    for (std::uint32_t i = 0; i < table.size(); i++) {
+        std::uint32_t value = i;
+        for (int bit = 0; bit < 8; bit++) {
+            value = (value & 1) ? (0xEDB88320u ^ (value >> 1)) : (value >> 1);
+        }
+        table[i] = value;
+    }
+
+    return table;
+}
+
+static constexpr auto crc32_table = make_crc32_table();
+
+std::uint32_t crc32(std::string_view data) {
+    std::uint32_t crc = 0xFFFFFFFFu;
+
+    for (unsigned char c : data) {
+        crc = crc32_table[(crc ^ c) & 0xFF] ^ (crc >> 8);
+    }
+
+    return crc ^ 0xFFFFFFFFu;
+}
+
+static void append_le32(std::string& output, std::uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        output.push_back(static_cast<char>((value >> (i * 8)) & 0xFF));
+    }
+}
+
+std::string gzip_compress(std::string_view data, int level) {
+    // the window and the hash tables are allocated once per thread, and kept between the calls
+    thread_local beast::zlib::deflate_stream deflater;
+    deflater.reset(level, 15, 8, beast::zlib::Strategy::normal);
+
+    // the magic number, the deflate method, no flags or modification time and an unknown OS
+    std::string output = { '\x1f', '\x8b', '\x08', '\0', '\0', '\0', '\0', '\0', '\0', '\xff' };
+    const std::size_t header_size = output.size();
+
+    output.resize(header_size + deflater.upper_bound(data.size()));
+
+    beast::zlib::z_params params;
+    params.next_in = data.data();
+    params.avail_in = data.size();
+    params.next_out = output.data() + header_size;
+    params.avail_out = output.size() - header_size;
+
+    beast::error_code ec;
+    deflater.write(params, beast::zlib::Flush::finish, ec);
+
+    if (ec != beast::zlib::error::end_of_stream) {
+        throw std::runtime_error("couldn't compress the data: " + ec.message());
+    }
+
+    output.resize(header_size + params.total_out);
+
+    append_le32(output, crc32(data));
+    append_le32(output, static_cast<std::uint32_t>(data.size()));
+
+    return output;
+}
+
+static bool iequals(std::string_view a, std::string_view b) {
+    return std::equal(
+        a.begin(), a.end(), b.begin(), b.end(),
+        [](char x, char y) { return std::tolower(static_cast<unsigned char>(x)) == std::tolower(static_cast<unsigned char>(y)); }
+    );
+}
+
+bool accepts_gzip(std::string_view accept_encoding) {
+    // a coding is accepted unless it's quality is 0, a wildcard covers the codings not listed
+    std::optional<bool> gzip_accepted;
+    bool wildcard_accepted = false;
+
+    while (!accept_encoding.empty()) {
+        const auto comma = accept_encoding.find(',');
+        std::string_view coding = accept_encoding.substr(0, comma);
+        accept_encoding = comma == std::string_view::npos ? std::string_view() : accept_encoding.substr(comma + 1);
+
+        bool accepted = true;
+        const auto semicolon = coding.find(';');
+        if (semicolon != std::string_view::npos) {
+            std::string_view params = coding.substr(semicolon + 1);
+            coding = coding.substr(0, semicolon);
+
+            const auto q = params.find("q=");
+            if (q != std::string_view::npos) {
+                std::string_view quality = params.substr(q + 2);
+                quality = quality.substr(0, quality.find_first_of(" ;"));
+                accepted = quality.find_first_not_of("0.") != std::string_view::npos;
+            }
+        }
+
+        const auto start = coding.find_first_not_of(" \t");
+        if (start == std::string_view::npos) {
+            continue;
+        }
+        coding = coding.substr(start, coding.find_last_not_of(" \t") - start + 1);
+
+        if (iequals(coding, "gzip") || iequals(coding, "x-gzip")) {
+            gzip_accepted = accepted;
+        }
+        else if (coding == "*") {
+            wildcard_accepted = accepted;
+        }
+    }
+
+    return gzip_accepted.value_or(wildcard_accepted);
+}
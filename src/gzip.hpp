@@ -0,0 +1,18 @@
+#ifndef GZIP_HPP
+#define GZIP_HPP
+
+#include <string>
+#include <string_view>
+#include <cstdint>
+
+// the CRC-32 checksum of the gzip trailer
+std::uint32_t crc32(std::string_view data);
+
+// compresses the data into the gzip format, using a Beast deflate stream reused by the thread,
+// the level goes from 0 (no compression) to 9 (best compression)
+std::string gzip_compress(std::string_view data, int level = 6);
+
+// whether an Accept-Encoding field value allows a gzip response
+bool accepts_gzip(std::string_view accept_encoding);
+
+#endif
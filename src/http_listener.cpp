@@ -3,16 +3,18 @@
 http_listener::http_listener(
     net::io_context& ioc,
     tcp::endpoint endpoint,
-    std::shared_ptr<const std::string> doc_root,
+    std::shared_ptr<asset_cache> assets,
+    std::shared_ptr<client_config_cache> client_configs,
 	std::shared_ptr<common_state> comstate,
-    std::shared_ptr<arduino_messenger> arduino_connection,
+    std::shared_ptr<device_pool> devices,
     std::shared_ptr<auth_table_t> auth_table,
     std::shared_ptr<gc_config> config
 ) : ioc(ioc),
     acceptor(net::make_strand(ioc)),
-    doc_root(doc_root),
+    assets(assets),
+    client_configs(client_configs),
     comstate(comstate),
-    arduino_connection(arduino_connection),
+    devices(devices),
     auth_table(auth_table),
     config(config)
 {
@@ -61,7 +63,7 @@ void http_listener::do_accept() {
     );
 }
 
-void http_listener::on_accept(beast::error_code ec, tcp::socket socket) {
+void http_listener::on_accept(beast::error_code ec, session_socket socket) {
     if (ec) {
         std::cerr << "Couldn't accept incoming connection: " << ec.message() << std::endl;
         return;
@@ -78,11 +80,14 @@ void http_listener::on_accept(beast::error_code ec, tcp::socket socket) {
         );
     }
 
-    std::make_shared<http_session>(
+    // the memory of the finished sessions is reused
+    std::allocate_shared<http_session>(
+        session_pool_allocator<http_session>(),
         std::move(socket),
-        doc_root,
+        assets,
+        client_configs,
         comstate,
-        arduino_connection,
+        devices,
         auth_table,
         opaque,
         associated_nonces.at(remote_address),
@@ -23,9 +23,10 @@ using tcp = net::ip::tcp;
 class http_listener : public std::enable_shared_from_this<http_listener> {
     net::io_context& ioc;
     tcp::acceptor acceptor;
-    std::shared_ptr<const std::string> doc_root;
+    std::shared_ptr<asset_cache> assets;
+    std::shared_ptr<client_config_cache> client_configs;
     std::shared_ptr<common_state> comstate;
-    std::shared_ptr<arduino_messenger> arduino_connection;
+    std::shared_ptr<device_pool> devices;
     std::shared_ptr<auth_table_t> auth_table;
 
     std::shared_ptr<std::string> opaque;
@@ -37,9 +38,10 @@ public:
     http_listener(
         net::io_context& ioc,
         tcp::endpoint endpoint,
-        std::shared_ptr<const std::string> doc_root,
+        std::shared_ptr<asset_cache> assets,
+        std::shared_ptr<client_config_cache> client_configs,
         std::shared_ptr<common_state> comstate,
-        std::shared_ptr<arduino_messenger> arduino_connection,
+        std::shared_ptr<device_pool> devices,
         std::shared_ptr<auth_table_t> auth_table,
         std::shared_ptr<gc_config> config
     );
@@ -48,7 +50,7 @@ public:
 
 private:
     void do_accept();
-    void on_accept(beast::error_code ec, tcp::socket socket);
+    void on_accept(beast::error_code ec, session_socket socket);
 };
 
 #endif
\ No newline at end of file
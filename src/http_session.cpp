@@ -1,50 +1,104 @@
 #include "http_session.hpp"
 
+#include <charconv>
+
+#ifdef __linux__
+#include <sys/sendfile.h>
+#include <cerrno>
+#include <climits>
+#endif
+
 http_session::http_session(
-    tcp::socket&& socket,
-    std::shared_ptr<const std::string> doc_root,
+    session_socket&& socket,
+    std::shared_ptr<asset_cache> assets,
+    std::shared_ptr<client_config_cache> client_configs,
     std::shared_ptr<common_state> comstate,
-    std::shared_ptr<arduino_messenger> arduino_connection,
+    std::shared_ptr<device_pool> devices,
     std::shared_ptr<auth_table_t> auth_table,
     std::shared_ptr<std::string> opaque,
     std::shared_ptr<std::string> nonce,
     std::shared_ptr<gc_config> config
 ) : stream(std::move(socket)),
-    doc_root(doc_root),
+    buffer(buffer_pool::take()),
+    assets(assets),
+    client_configs(client_configs),
     comstate(comstate),
-    arduino_connection(arduino_connection),
+    devices(devices),
     auth_table(auth_table),
     opaque(opaque),
     nonce(nonce),
+    deadline_timer(stream.get_executor()),
+    file_wait_timer(stream.get_executor()),
     config(config)
 {
     static_assert(queue_limit > 0, "queue limit must be non-zero and positive");
-    response_queue.reserve(queue_limit);
+}
+
+http_session::~http_session() {
+    // the next session of the thread gets the grown buffer
+    buffer_pool::give_back(std::move(buffer));
 }
 
 void http_session::run() {
     net::dispatch(
         stream.get_executor(),
-        beast::bind_front_handler(
-            &http_session::do_read,
-            shared_from_this()
-        )
+        [self = shared_from_this()] {
+            // without it, a pipelined response waits until the client acknowledges the one before it,
+            // which clients delay by tens of milliseconds, it only speeds things up, so failing to set it is fine
+            beast::error_code ec;
+            self->stream.socket().set_option(tcp::no_delay(true), ec);
+
+            self->do_read();
+            self->wait_deadline();
+        }
+    );
+}
+
+void http_session::wait_deadline() {
+    deadline_timer.expires_at(deadline);
+
+    // the timer doesn't keep the session alive, it's wait is cancelled when the session is destroyed
+    deadline_timer.async_wait(
+        [weak_self = weak_from_this()](beast::error_code ec) {
+            const auto self = weak_self.lock();
+            if (!self || ec == net::error::operation_aborted) {
+                return;
+            }
+
+            // the client sent something since the wait started
+            if (self->deadline > std::chrono::steady_clock::now()) {
+                return self->wait_deadline();
+            }
+
+            self->stream.close();
+        }
     );
 }
 
 void http_session::do_read() {
-    // make a new parser for each request
-    parser.emplace();
+    // the previous request was handled by now, so it's memory is reused for the next one,
+    // the parser is made in the same storage every time
+    parser.reset();
+    arena.release();
+    parser.emplace(
+        std::piecewise_construct,
+        std::make_tuple(request_allocator(&arena)),
+        std::make_tuple(request_allocator(&arena))
+    );
 
     // set a max body size of 10k to prevent abuse
     parser->body_limit(10000);
 
-    stream.expires_after(std::chrono::seconds(30));
+    deadline = std::chrono::steady_clock::now() + idle_timeout;
 
+    // the operations of the read are allocated in the arena as well
     http::async_read(stream, buffer, *parser,
-        beast::bind_front_handler(
-            &http_session::on_read,
-            shared_from_this()
+        net::bind_allocator(
+            request_allocator(&arena),
+            beast::bind_front_handler(
+                &http_session::on_read,
+                shared_from_this()
+            )
         )
     );
 }
@@ -55,9 +109,14 @@ void http_session::on_read(
 ) {
     boost::ignore_unused(bytes_transferred);
 
-    // if the client closed the connection
+    // if the client closed the connection, the responses to it's last requests are still sent
     if (ec == http::error::end_of_stream) {
-        return do_close();
+        if (response_queue.empty()) {
+            return do_close();
+        }
+
+        read_closed = true;
+        return;
     }
 
     if (ec) {
@@ -67,173 +126,161 @@ void http_session::on_read(
 
     // if the request is a WebSocket Upgrade
     if (websocket::is_upgrade(parser->get())) {
-        // make sure the authentication is valid (it is most definitely not)
-
-        auto req = parser->release();
-        const std::string auth_field = req.at(http::field::authorization);
-        const auto digest_opt = parse_digest_auth_field(auth_field);
-        if (!digest_opt) {
-            queue_write(
-                unauthorized_response(*nonce, *opaque, req, req.target(), false)
-            );
-
-            return;
-        }
-
-        const std::string& request_nonce = digest_opt.value().nonce;
-        if (request_nonce != *nonce) {
-            queue_write(
-                unauthorized_response(*nonce, *opaque, req, req.target(), true)
-            );
-
+        // the responses to the requests before it are written first
+        if (!response_queue.empty()) {
+            upgrade_pending = true;
+            read_paused = true;
             return;
         }
 
-        // create a new websocket session, moving the socket and request into it
-        auto session = 
-            std::make_shared<websocket_session>(
-				stream.release_socket(),
-                arduino_connection
-			);
-
-        session->do_accept(req, auth_table, *nonce, *opaque);
-        comstate->add_session(session);
-        
-        return;
+        return do_upgrade();
     }
 
     // send the response back
     queue_write(
-        handle_request(*doc_root, parser->release(), auth_table, *nonce, *opaque, config)
+        handle_request(
+            *assets,
+            *client_configs,
+            *comstate,
+            parser->release(),
+            auth_table,
+            *nonce,
+            *opaque,
+            config,
+            response_allocator(&response_arena)
+        )
     );
 
-    // if the response queue is not at it's limit, try to add another response to the queue
-    if (response_queue.size() < queue_limit) {
-        do_read();
-    }
+    continue_reading();
 }
 
-void http_session::queue_write(http::message_generator msg) {
-    // store the work
-    response_queue.push_back(std::move(msg));
+bool http_session::can_read_ahead() const {
+    return !response_queue.full() && arena_responses < response_arena_limit;
+}
 
-    // if there wasn't any work before, start the write loop
-    if (response_queue.size() == 1) {
-        do_write();
+void http_session::continue_reading() {
+    // read the next request while the responses are written, as long as there's room for it's response
+    if (can_read_ahead()) {
+        do_read();
+    }
+    else {
+        read_paused = true;
     }
 }
 
-bool http_session::do_write() {
-    const bool was_full = response_queue.size() == queue_limit;
-
-    if (!response_queue.empty()) {
-        http::message_generator msg = std::move(response_queue.front());
-        response_queue.erase(response_queue.begin());
+void http_session::do_upgrade() {
+    // make sure the authentication is valid (it is most definitely not)
 
-        bool keep_alive = msg.keep_alive();
+    auto req = parser->release();
+    const std::string auth_field = req.at(http::field::authorization);
+    const auto digest_opt = parse_digest_auth_field(auth_field);
+    if (!digest_opt) {
+        queue_write(
+            unauthorized_response(*nonce, *opaque, req, req.target(), response_allocator(&response_arena), false)
+        );
 
-        // prevent multiple simultaneous async writes
-        write_semaphore.acquire();
+        return continue_reading();
+    }
 
-        beast::async_write(
-            stream,
-            std::move(msg),
-            beast::bind_front_handler(
-                &http_session::on_write,
-                shared_from_this(),
-                keep_alive
-            )
+    const std::string& request_nonce = digest_opt.value().nonce;
+    if (request_nonce != *nonce) {
+        queue_write(
+            unauthorized_response(*nonce, *opaque, req, req.target(), response_allocator(&response_arena), true)
         );
+
+        return continue_reading();
     }
 
-    return was_full;
+    // create a new websocket session, moving the socket and request into it
+    auto session = 
+        std::allocate_shared<websocket_session>(
+            session_pool_allocator<websocket_session>(),
+            stream.release_socket(),
+            devices,
+            config
+        );
+
+    session->do_accept(req, auth_table, *nonce, *opaque);
+    // the page already has the gate states it embedded, unless they changed since
+    comstate->add_session(session, get_state_version(req.target()));
 }
 
-std::string path_cat(
-    beast::string_view base,
-    beast::string_view path
-) {
-    if (base.empty()) {
-        return std::string(path);
-    }
-    std::string result(base);
-
-#ifdef BOOST_MSVC
-    char constexpr path_separator = '\\';
-    // if a path separator is present at the end of the base, remove it
-    if (result.back() == path_separator) {
-        result.resize(result.size() - 1);
-    }
-    result.append(path.data(), path.size());
-    // replace any unix-like path separators with windows ones
-    for (auto& c : result) {
-        if (c == '/') {
-            c = path_separator;
-        }
+void http_session::queue_write(http_response response) {
+    // store the work, a file's body is sent after it's header
+    if (auto* file = std::get_if<file_response>(&response)) {
+        response_queue.emplace(
+            queued_response{ std::move(file->header), std::move(file->body) }
+        );
     }
-#else
-    char constexpr path_separator = '/';
-    if (result.back() == path_separator) {
-        result.resize(result.size() - 1);
+    else {
+        response_queue.emplace(
+            queued_response{ std::move(std::get<http_message>(response)), std::nullopt }
+        );
+    }
+    arena_responses++;
+
+    // if there wasn't any work before, start the write loop,
+    // otherwise the response is written after the ones before it
+    if (response_queue.size() == 1) {
+        do_write();
     }
-    result.append(path.data(), path.size());
-#endif
-    return result;
 }
 
-beast::string_view mime_type(
-    beast::string_view path
-) {
-    using beast::iequals;
-    // get the extension part of the path (after the last dot)
-    const auto ext = [&path]{
-        const auto pos = path.rfind(".");
-        // if there is no dot in the path, there is no extension
-        if (pos == beast::string_view::npos) {
-            return beast::string_view{};
-        }
-        return path.substr(pos);
-    }();
-
-    if (iequals(ext, ".htm"))       return "text/html";
-    if (iequals(ext, ".html"))      return "text/html";
-    if (iequals(ext, ".php"))       return "text/html";
-    if (iequals(ext, ".css"))       return "text/css";
-    if (iequals(ext, ".txt"))       return "text/plain";
-    if (iequals(ext, ".js"))        return "application/javascript";
-    if (iequals(ext, ".json"))      return "application/json";
-    if (iequals(ext, ".xml"))       return "application/xml";
-    if (iequals(ext, ".swf"))       return "application/x-shockwave-flash";
-    if (iequals(ext, ".flv"))       return "video/x-flv";
-    if (iequals(ext, ".png"))       return "image/png";
-    if (iequals(ext, ".jpe"))       return "image/jpeg";
-    if (iequals(ext, ".jpeg"))      return "image/jpeg";
-    if (iequals(ext, ".jpg"))       return "image/jpeg";
-    if (iequals(ext, ".gif"))       return "image/gif";
-    if (iequals(ext, ".bmp"))       return "image/bmp";
-    if (iequals(ext, ".ico"))       return "image/vnd.microsoft.icon";
-    if (iequals(ext, ".tiff"))      return "image/tiff";
-    if (iequals(ext, ".tif"))       return "image/tiff";
-    if (iequals(ext, ".svg"))       return "image/svg+xml";
-    if (iequals(ext, ".svgz"))      return "image/svg+xml";
-    return "application/text";
+void http_session::do_write() {
+    // the response stays at the front of the queue until it's written,
+    // so a response queued meanwhile doesn't start another write
+    queued_response& response = response_queue.front();
+    sending_file = std::move(response.file);
+
+    std::visit(
+        [this](auto& message) {
+            const bool keep_alive = message.keep_alive();
+
+            // the serializer and the operations of the write are allocated in the arena as well
+            http::async_write(
+                stream,
+                message,
+                net::bind_allocator(
+                    response_allocator(&response_arena),
+                    beast::bind_front_handler(
+                        &http_session::on_write,
+                        shared_from_this(),
+                        keep_alive
+                    )
+                )
+            );
+        },
+        response.message
+    );
+}
+
+template <class Body>
+arena_response<Body> make_response(http::status status, unsigned int version, response_allocator allocator) {
+    arena_response<Body> res{
+        std::piecewise_construct,
+        std::make_tuple(),
+        std::make_tuple(allocator)
+    };
+
+    res.result(status);
+    res.version(version);
+
+    return res;
 }
 
 template <class Body, class Allocator>
-http::response<http::string_body> unauthorized_response(
+arena_response<http::string_body> unauthorized_response(
     std::string& nonce,
     const std::string& opaque,
     http::request<Body, http::basic_fields<Allocator>>& req,
     beast::string_view target,
+    response_allocator allocator,
     bool stale
 ) {
 	// generate a new nonce for a 401 status
 	nonce = generate_base64_str(NONCE_SIZE);
 
-	http::response<http::string_body> res{
-		http::status::unauthorized,
-		req.version()
-	};
+	auto res = make_response<http::string_body>(http::status::unauthorized, req.version(), allocator);
 
 	res.set(http::field::server, VERSION);
 	res.set(
@@ -247,40 +294,109 @@ http::response<http::string_body> unauthorized_response(
 	return res;
 }
 
-bool is_target_single_level(std::string_view target, std::string endpoint_name) {
-    return
-        target.starts_with("/" + endpoint_name) &&
-        (target.ends_with(endpoint_name + "/") || target.ends_with(endpoint_name));
-}
+bool etag_matches(std::string_view if_none_match, std::string_view etag) {
+    while (!if_none_match.empty()) {
+        const auto comma = if_none_match.find(',');
+        std::string_view candidate = if_none_match.substr(0, comma);
+        if_none_match = comma == std::string_view::npos ? std::string_view() : if_none_match.substr(comma + 1);
 
-bool target_starts_with_segment(std::string_view target, std::string endpoint_name) {
-    std::string starting_part = "/" + endpoint_name;
-    if (target.starts_with(starting_part)) {
-        if (starting_part.size() == target.size()) {
-            return true;
+        const auto start = candidate.find_first_not_of(" \t");
+        if (start == std::string_view::npos) {
+            continue;
+        }
+        candidate = candidate.substr(start, candidate.find_last_not_of(" \t") - start + 1);
+
+        // If-None-Match uses the weak comparison
+        if (candidate.starts_with("W/")) {
+            candidate.remove_prefix(2);
         }
 
-        return target[starting_part.size()] == '/';
+        if (candidate == "*" || candidate == etag) {
+            return true;
+        }
     }
 
     return false;
 }
 
+std::string embed_bootstrap(
+    std::string_view page,
+    std::string_view map_config,
+    const common_state::gate_snapshot& snapshot
+) {
+    const std::string bootstrap =
+        "{\"config\":" + std::string(map_config) +
+        ",\"states\":" + snapshot.states.dump() +
+        ",\"stateVersion\":" + std::to_string(snapshot.version) + "}";
+
+    const std::size_t head_end = std::min(page.find("</head>"), page.size());
+
+    std::string output;
+    output.reserve(page.size() + bootstrap.size() + 64);
+    output.append(page.substr(0, head_end));
+    output.append("<script id=\"bootstrap\" type=\"application/json\">");
+
+    // a '<' can only be in the strings of the JSON, where it's escaped,
+    // so a "</script>" or "<!--" in the config can't change how the page is parsed
+    for (char c : bootstrap) {
+        if (c == '<') {
+            output.append("\\u003c");
+        }
+        else {
+            output.push_back(c);
+        }
+    }
+
+    output.append("</script>\n");
+    output.append(page.substr(head_end));
+
+    return output;
+}
+
+std::optional<std::uint64_t> get_state_version(std::string_view target) {
+    const auto question_mark = target.find('?');
+    if (question_mark == std::string_view::npos) {
+        return std::nullopt;
+    }
+
+    std::string_view query = target.substr(question_mark + 1);
+    while (!query.empty()) {
+        const auto ampersand = query.find('&');
+        const std::string_view parameter = query.substr(0, ampersand);
+        query = ampersand == std::string_view::npos ? std::string_view() : query.substr(ampersand + 1);
+
+        constexpr std::string_view key = "stateVersion=";
+        if (!parameter.starts_with(key)) {
+            continue;
+        }
+
+        std::uint64_t version = 0;
+        const auto [end, ec] = std::from_chars(parameter.data() + key.size(), parameter.data() + parameter.size(), version);
+        if (ec != std::errc() || end != parameter.data() + parameter.size()) {
+            return std::nullopt;
+        }
+
+        return version;
+    }
+
+    return std::nullopt;
+}
+
 template <class Body, class Allocator>
-http::message_generator handle_request(
-    beast::string_view doc_root,
+http_response handle_request(
+    const asset_cache& assets,
+    const client_config_cache& client_configs,
+    common_state& comstate,
     http::request<Body, http::basic_fields<Allocator>>&& req,
     std::shared_ptr<auth_table_t> auth_table,
     std::string& nonce,
     std::string& opaque,
-    std::shared_ptr<gc_config> config
+    std::shared_ptr<gc_config> config,
+    response_allocator allocator
 ) {
     const auto bad_request = 
-        [&req] (beast::string_view why) {
-            http::response<http::string_body> res{
-                http::status::bad_request,
-                req.version()
-            };
+        [&req, allocator] (beast::string_view why) {
+            auto res = make_response<http::string_body>(http::status::bad_request, req.version(), allocator);
 
             res.set(http::field::server, VERSION);
             res.set(http::field::content_type, "text/html");
@@ -292,11 +408,8 @@ http::message_generator handle_request(
         };
     
     const auto not_found = 
-        [&req] (beast::string_view target) {
-            http::response<http::string_body> res{
-                http::status::not_found,
-                req.version()
-            };
+        [&req, allocator] (beast::string_view target) {
+            auto res = make_response<http::string_body>(http::status::not_found, req.version(), allocator);
 
             res.set(http::field::server, VERSION);
             res.set(http::field::content_type, "text/html");
@@ -308,11 +421,8 @@ http::message_generator handle_request(
         };
 
     const auto server_error = 
-        [&req] (beast::string_view what) {
-            http::response<http::string_body> res{
-                http::status::internal_server_error,
-                req.version()
-            };
+        [&req, allocator] (beast::string_view what) {
+            auto res = make_response<http::string_body>(http::status::internal_server_error, req.version(), allocator);
 
             res.set(http::field::server, VERSION);
             res.set(http::field::content_type, "text/html");
@@ -324,11 +434,8 @@ http::message_generator handle_request(
         };
 
     const auto forbidden =
-        [&req](beast::string_view target) {
-			http::response<http::string_body> res{
-				http::status::forbidden,
-				req.version()
-			};
+        [&req, allocator](beast::string_view target) {
+			auto res = make_response<http::string_body>(http::status::forbidden, req.version(), allocator);
 
 			res.set(http::field::server, VERSION);
 			res.keep_alive(req.keep_alive());
@@ -355,23 +462,24 @@ http::message_generator handle_request(
         return bad_request("Illegal request target");
     }
 
-    // if the request target is not the root page...
-    if (const auto endpoint_perms = get_endpoint_permissions(req.target())) {
+    const route target_route = resolve_route(req.target());
+    const auto& endpoint_perms = target_route.permissions;
+
+    // the client is authenticated once, the endpoints use it's data
+    const std::optional<auth_data> auth =
+        endpoint_perms && endpoint_perms.value() != Blocked
+            ? get_auth(req, *auth_table, nonce, opaque)
+            : std::nullopt;
+
+    // if the request target is not a public file...
+    if (endpoint_perms) {
         if (endpoint_perms.value() == Blocked) {
             return forbidden(req.target());
         }
 
 		// make sure the client has sufficient permissions
-		if (
-			req.find(http::field::authorization) == req.end()
-		) {
-            return unauthorized_response(nonce, opaque, req, req.target());
-		}
-
-		const auto auth = get_auth(req, *auth_table, nonce, opaque);
-
 		if (!auth) {
-            return unauthorized_response(nonce, opaque, req, req.target());
+            return unauthorized_response(nonce, opaque, req, req.target(), allocator);
 		}
 
         if (auth->permissions < endpoint_perms.value()) {
@@ -381,35 +489,68 @@ http::message_generator handle_request(
 
     std::string path;
 
-    if (is_target_single_level(req.target(), "config")) {
-		std::optional<auth_data> user_auth_data = get_auth(req, *auth_table, nonce, opaque);
+    if (
+        target_route.handler == ConfigHandler &&
+        (target_route.rest.empty() || target_route.rest == "/")
+    ) {
+        const client_config_cache::rendered_config& map_config = client_configs.get(auth.value());
+
+        // the compressed variant is sent to the clients that accept it
+        const bool use_gzip =
+            map_config.gzip_body &&
+            req.find(http::field::accept_encoding) != req.end() &&
+            accepts_gzip(req[http::field::accept_encoding]);
+
+        const std::string_view body = use_gzip ? std::string_view(map_config.gzip_body.value()) : map_config.body;
+        const std::string& etag = use_gzip ? map_config.gzip_etag : map_config.etag;
+
+        const auto set_config_fields =
+            [&](auto& res) {
+                res.set(http::field::server, VERSION);
+                res.set(http::field::etag, etag);
+                // the config differs between the users, and has to be checked every time
+                res.set(http::field::cache_control, "private, no-cache");
+                if (map_config.gzip_body) {
+                    res.set(http::field::vary, "Accept-Encoding");
+                }
+                res.keep_alive(req.keep_alive());
+            };
+
+        // the client's copy is still current
+        if (
+            req.find(http::field::if_none_match) != req.end() &&
+            etag_matches(req[http::field::if_none_match], etag)
+        ) {
+            auto res = make_response<http::empty_body>(http::status::not_modified, req.version(), allocator);
 
-        std::string map_config = config->get_maps_for_client(user_auth_data.value());
+            set_config_fields(res);
+
+            return res;
+        }
 
         if (req.method() == http::verb::head) {
-			http::response<http::empty_body> res{
-				http::status::ok,
-				req.version()
-			};
+			auto res = make_response<http::empty_body>(http::status::ok, req.version(), allocator);
 
-			res.set(http::field::server, VERSION);
+			set_config_fields(res);
 			res.set(http::field::content_type, "application/json");
-			res.content_length(map_config.size());
-			res.keep_alive(req.keep_alive());
+			if (use_gzip) {
+				res.set(http::field::content_encoding, "gzip");
+			}
+			res.content_length(body.size());
 
 			return res;
         }
         else if (req.method() == http::verb::get) {
-            http::response<http::string_body> res{
-                http::status::ok,
-                req.version()
-            };
+            // the cache never drops a render, so the response can refer to it's body without a copy
+            auto res = make_response<http::span_body<const char>>(http::status::ok, req.version(), allocator);
+            res.body() = { body.data(), body.size() };
 
-			res.set(http::field::server, VERSION);
+			set_config_fields(res);
 			res.set(http::field::content_type, "application/json");
-			res.content_length(map_config.size());
-			res.keep_alive(req.keep_alive());
-            res.body() = map_config;
+			if (use_gzip) {
+				res.set(http::field::content_encoding, "gzip");
+			}
+			res.content_length(body.size());
 
             return res;
         }
@@ -417,13 +558,13 @@ http::message_generator handle_request(
             return bad_request("Invalid method on /config");
         }
     }
-    if (target_starts_with_segment(req.target(), "maps")) {
+    if (target_route.handler == MapHandler) {
         // determine which map to send to the client
-        if (req.target() == "/maps" || req.target() == "/maps/") {
+        if (target_route.rest.empty() || target_route.rest == "/") {
             return not_found(req.target());
         }
 
-        std::string id = req.target().substr(6);
+        const std::string_view id = target_route.rest.substr(1);
 
         try {
 			path = config->get_map_by_id(id).map_image_path;
@@ -433,29 +574,141 @@ http::message_generator handle_request(
         }
     }
     else {
-		// build requested file path
-		path = path_cat(doc_root, req.target());
+        // the client's files are compiled into the server
+        std::string_view asset_path = target_route.asset_path;
+
+        // the index pages of the other directories aren't in the route table
+        std::string directory_index;
+        if (asset_path.back() == '/') {
+            directory_index = std::string(asset_path) + "index.html";
+            asset_path = directory_index;
+        }
 
-		if (
-			req.target().back() == '/'
-		) {
-			path.append("index.html");
-		}
-		else if (
-			std::find(
-				indexable_endpoints.begin(),
-				indexable_endpoints.end(),
-				req.target()
-			) != indexable_endpoints.end()
-		) {
-			path.append("/index.html");
-		}
+        const asset_cache::asset* asset = assets.get(asset_path);
+        if (!asset) {
+            return not_found(req.target());
+        }
+
+        // the pages of the app get the map config and the gate states embedded,
+        // so they can show the gates without waiting for other requests
+        if (target_route.has_bootstrap) {
+            std::string page =
+                embed_bootstrap(
+                    asset->body,
+                    client_configs.get(auth.value()).body,
+                    comstate.get_snapshot()
+                );
+
+            const bool use_gzip =
+                page.size() >= config->compression.min_size &&
+                req.find(http::field::accept_encoding) != req.end() &&
+                accepts_gzip(req[http::field::accept_encoding]);
+
+            if (use_gzip) {
+                page = gzip_compress(page, config->compression.level);
+            }
+
+            const auto set_page_fields =
+                [&](auto& res) {
+                    res.set(http::field::server, VERSION);
+                    res.set(http::field::content_type, asset->content_type);
+                    // the page has the current gate states, so it's generated for every request
+                    res.set(http::field::cache_control, "private, no-cache");
+                    res.set(http::field::vary, "Accept-Encoding");
+                    if (use_gzip) {
+                        res.set(http::field::content_encoding, "gzip");
+                    }
+                    res.keep_alive(req.keep_alive());
+                };
+
+            if (req.method() == http::verb::head) {
+                auto res = make_response<http::empty_body>(http::status::ok, req.version(), allocator);
+
+                set_page_fields(res);
+                res.content_length(page.size());
+
+                return res;
+            }
+
+            auto res = make_response<http::string_body>(http::status::ok, req.version(), allocator);
+
+            set_page_fields(res);
+            res.body() = std::move(page);
+            res.prepare_payload();
+
+            return res;
+        }
+
+        // the compressed variant is sent to the clients that accept it
+        const bool use_gzip =
+            asset->gzip_body &&
+            req.find(http::field::accept_encoding) != req.end() &&
+            accepts_gzip(req[http::field::accept_encoding]);
+
+        const std::string_view body = use_gzip ? std::string_view(asset->gzip_body.value()) : asset->body;
+        const std::string& etag = use_gzip ? asset->gzip_etag : asset->etag;
+
+        const auto set_asset_fields =
+            [&](auto& res) {
+                res.set(http::field::server, VERSION);
+                res.set(http::field::etag, etag);
+                // the hashed paths always refer to the same content,
+                // the browsers can keep the other files, but have to check they're current
+                if (asset->is_immutable) {
+                    res.set(http::field::cache_control, "public, max-age=31536000, immutable");
+                }
+                else {
+                    res.set(http::field::cache_control, "no-cache");
+                }
+                if (asset->gzip_body) {
+                    res.set(http::field::vary, "Accept-Encoding");
+                }
+                res.keep_alive(req.keep_alive());
+            };
+
+        // the client's copy is still current
+        if (
+            req.find(http::field::if_none_match) != req.end() &&
+            etag_matches(req[http::field::if_none_match], etag)
+        ) {
+            auto res = make_response<http::empty_body>(http::status::not_modified, req.version(), allocator);
+
+            set_asset_fields(res);
+
+            return res;
+        }
+
+        if (req.method() == http::verb::head) {
+            auto res = make_response<http::empty_body>(http::status::ok, req.version(), allocator);
+
+            set_asset_fields(res);
+            res.set(http::field::content_type, asset->content_type);
+            if (use_gzip) {
+                res.set(http::field::content_encoding, "gzip");
+            }
+            res.content_length(body.size());
+
+            return res;
+        }
+
+        // the cache never drops an asset, so the response can refer to it's body without a copy
+        auto res = make_response<http::span_body<const char>>(http::status::ok, req.version(), allocator);
+        res.body() = { body.data(), body.size() };
+
+        set_asset_fields(res);
+        res.set(http::field::content_type, asset->content_type);
+        if (use_gzip) {
+            res.set(http::field::content_encoding, "gzip");
+        }
+        res.content_length(body.size());
+
+        return res;
     }
 
     // open the file
     beast::error_code ec;
-    http::file_body::value_type body;
-    body.open(path.c_str(), beast::file_mode::scan, ec);
+    file_range file;
+    file.file.open(path.c_str(), beast::file_mode::scan, ec);
 
     // if the file doesn't exist, return the 404 error
     if (ec == beast::errc::no_such_file_or_directory) {
@@ -468,35 +721,68 @@ http::message_generator handle_request(
     }
 
     // save the size of the file for later
-    const auto size = body.size();
+    const auto size = file.file.size(ec);
+    if (ec) {
+        return server_error(ec.message());
+    }
 
-    // if the request method is HEAD
-    if (req.method() == http::verb::head) {
-        http::response<http::empty_body> res{
-            http::status::ok,
-            req.version()
-        };
+    const std::string etag = make_file_etag(path, size);
 
-        res.set(http::field::server, VERSION);
-        res.set(http::field::content_type, mime_type(path));
-        res.content_length(size);
-        res.keep_alive(req.keep_alive());
+    auto res = make_response<http::empty_body>(http::status::ok, req.version(), allocator);
 
+    res.set(http::field::server, VERSION);
+    res.set(http::field::content_type, mime_type(path));
+    res.set(http::field::etag, etag);
+    res.set(http::field::accept_ranges, "bytes");
+    res.keep_alive(req.keep_alive());
+
+    // the client's copy is still current
+    if (
+        req.find(http::field::if_none_match) != req.end() &&
+        etag_matches(req[http::field::if_none_match], etag)
+    ) {
+        res.result(http::status::not_modified);
         return res;
     }
 
-    // if the request method is GET
-    http::response<http::file_body> res{
-        std::piecewise_construct,
-        std::make_tuple(std::move(body)),
-        std::make_tuple(http::status::ok, req.version())
-    };
+    file.length = size;
+
+    // a range of a file that changed since the client got the rest of it would be useless,
+    // so with a stale If-Range the whole file is sent
+    byte_range range{};
+    const RangeResult range_result =
+        req.find(http::field::range) == req.end() ||
+        (req.find(http::field::if_range) != req.end() && req[http::field::if_range] != beast::string_view(etag))
+            ? WholeFile
+            : parse_range(req[http::field::range], size, range);
+
+    if (range_result == UnsatisfiableRange) {
+        res.result(http::status::range_not_satisfiable);
+        res.set(http::field::content_range, "bytes */" + std::to_string(size));
+        res.content_length(0);
+        return res;
+    }
 
-    res.set(http::field::server, VERSION);
-    res.set(http::field::content_type, mime_type(path));
-    res.content_length(size);
-    res.keep_alive(req.keep_alive());
-    return res;
+    if (range_result == PartialFile) {
+        res.result(http::status::partial_content);
+        res.set(
+            http::field::content_range,
+            "bytes " + std::to_string(range.first) + "-" + std::to_string(range.last) + "/" + std::to_string(size)
+        );
+
+        file.offset = range.first;
+        file.length = range.last - range.first + 1;
+    }
+
+    res.content_length(file.length);
+
+    // if the request method is HEAD
+    if (req.method() == http::verb::head) {
+        return res;
+    }
+
+    // if the request method is GET
+    return file_response{ std::move(res), std::move(file) };
 }
 
 void http_session::on_write(
@@ -504,7 +790,12 @@ void http_session::on_write(
     beast::error_code ec,
     std::size_t bytes_transferred
 ) {
-    write_semaphore.release();
+    // the file's body follows it's header
+    if (!ec && sending_file) {
+        return do_send_file(keep_alive);
+    }
+
+    sending_file.reset();
     boost::ignore_unused(bytes_transferred);
 
     if (ec) {
@@ -516,11 +807,164 @@ void http_session::on_write(
         return do_close();
     }
 
-    if (do_write()) {
+    response_queue.pop();
+
+    // none of the written responses is used anymore, so their memory goes to the next ones
+    if (response_queue.empty()) {
+        response_arena.release();
+        arena_responses = 0;
+    }
+
+    if (!response_queue.empty()) {
+        do_write();
+    }
+    else if (upgrade_pending) {
+        upgrade_pending = false;
+        read_paused = false;
+        return do_upgrade();
+    }
+    else if (read_closed) {
+        return do_close();
+    }
+
+    // the reading stopped when the queue got full, or the arena was used up to it's limit
+    if (read_paused && !upgrade_pending && can_read_ahead()) {
+        read_paused = false;
         do_read();
     }
 }
 
+void http_session::do_send_file(bool keep_alive) {
+    file_range& file = sending_file.value();
+
+#ifdef __linux__
+    // the kernel copies the file to the socket, without passing it through the process
+    auto& socket = stream.socket();
+
+    beast::error_code ec;
+    socket.native_non_blocking(true, ec);
+    if (ec) {
+        return on_write(keep_alive, ec, 0);
+    }
+
+    while (file.length > 0) {
+        off_t offset = static_cast<off_t>(file.offset);
+        const ssize_t sent =
+            ::sendfile(
+                socket.native_handle(),
+                file.file.native_handle(),
+                &offset,
+                static_cast<std::size_t>(std::min<std::uint64_t>(file.length, SSIZE_MAX))
+            );
+
+        if (sent > 0) {
+            file.offset += sent;
+            file.length -= sent;
+            // the client is still reading, so a long transfer isn't cut off as an idle connection
+            deadline = std::chrono::steady_clock::now() + idle_timeout;
+            continue;
+        }
+
+        // the socket's buffer is full, continue once it drains,
+        // or give up if the client doesn't read for as long as a chunk may take
+        if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            deadline = std::chrono::steady_clock::now() + idle_timeout;
+            file_wait_timer.expires_after(std::chrono::seconds(30));
+            file_wait_timer.async_wait(
+                [self = shared_from_this()](beast::error_code ec) {
+                    if (ec != net::error::operation_aborted) {
+                        self->stream.socket().cancel(ec);
+                    }
+                }
+            );
+
+            socket.async_wait(
+                tcp::socket::wait_write,
+                [self = shared_from_this(), keep_alive](beast::error_code ec) {
+                    self->file_wait_timer.cancel();
+
+                    if (ec == net::error::operation_aborted && self->file_wait_timer.expiry() <= net::steady_timer::clock_type::now()) {
+                        ec = beast::error::timeout;
+                    }
+
+                    if (ec) {
+                        return self->on_write(keep_alive, ec, 0);
+                    }
+                    self->do_send_file(keep_alive);
+                }
+            );
+            return;
+        }
+
+        // the file got shorter than it's Content-Length
+        if (sent == 0) {
+            ec = net::error::eof;
+        }
+        else {
+            ec = beast::error_code(errno, boost::system::system_category());
+        }
+
+        sending_file.reset();
+        return on_write(keep_alive, ec, 0);
+    }
+
+    sending_file.reset();
+    on_write(keep_alive, {}, 0);
+#else
+    if (file.length == 0) {
+        sending_file.reset();
+        return on_write(keep_alive, {}, 0);
+    }
+
+    beast::error_code ec;
+    file_buffer.resize(static_cast<std::size_t>(std::min<std::uint64_t>(file.length, file_chunk_size)));
+
+    file.file.seek(file.offset, ec);
+    std::size_t read = 0;
+    if (!ec) {
+        read = file.file.read(file_buffer.data(), file_buffer.size(), ec);
+    }
+
+    if (!ec && read == 0) {
+        ec = net::error::eof;
+    }
+
+    if (ec) {
+        sending_file.reset();
+        return on_write(keep_alive, ec, 0);
+    }
+
+    file.offset += read;
+    file.length -= read;
+
+    deadline = std::chrono::steady_clock::now() + idle_timeout;
+    net::async_write(
+        stream,
+        net::buffer(file_buffer.data(), read),
+        beast::bind_front_handler(
+            &http_session::on_file_written,
+            shared_from_this(),
+            keep_alive
+        )
+    );
+#endif
+}
+
+void http_session::on_file_written(
+    bool keep_alive,
+    beast::error_code ec,
+    std::size_t bytes_transferred
+) {
+    boost::ignore_unused(bytes_transferred);
+
+    if (ec) {
+        sending_file.reset();
+        return on_write(keep_alive, ec, 0);
+    }
+
+    do_send_file(keep_alive);
+}
+
 void http_session::do_close() {
     beast::error_code ec;
     stream.socket().shutdown(tcp::socket::shutdown_send, ec);
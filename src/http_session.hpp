@@ -6,109 +6,219 @@
 #include <chrono>
 #include <array>
 #include <vector>
-#include <semaphore>
+#include <variant>
+#include <optional>
+#include <memory_resource>
+#include <cstddef>
+#include <cstdint>
 
 #include "common.hpp"
 
 #include <boost/beast/http/message.hpp>
-#include <boost/beast/http/message_generator.hpp>
 #include <boost/beast/http/read.hpp>
+#include <boost/beast/http/write.hpp>
 #include <boost/beast/http/status.hpp>
 #include <boost/beast/http/field.hpp>
 #include <boost/beast/http/verb.hpp>
-#include <boost/beast/http/file_body.hpp>
+#include <boost/beast/http/span_body.hpp>
+#include <boost/beast/http/string_body.hpp>
+#include <boost/beast/http/empty_body.hpp>
 #include <boost/beast/websocket/impl/rfc6455.hpp>
 #include <boost/beast/core/string_type.hpp>
 #include <boost/beast/core/error.hpp>
 #include <boost/beast/core/bind_handler.hpp>
 #include <boost/beast/core/tcp_stream.hpp>
 #include <boost/beast/core/flat_buffer.hpp>
-#include <boost/beast/core/buffers_generator.hpp>
 #include <boost/beast/core/string_type.hpp>
 #include <boost/beast/core/string.hpp>
 #include <boost/beast/core/file_base.hpp>
 
 #include <boost/asio/dispatch.hpp>
+#include <boost/asio/strand.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/bind_allocator.hpp>
+#include <boost/asio/steady_timer.hpp>
 
 #include <boost/optional/optional_fwd.hpp>
 
 #include "websocket_session.hpp"
-#include "arduino_messenger.hpp"
+#include "device_pool.hpp"
 #include "common_state.hpp"
 #include "auth.hpp"
 #include "config.hpp"
+#include "asset_cache.hpp"
+#include "client_config_cache.hpp"
+#include "gzip.hpp"
+#include "file_range.hpp"
+#include "ring_queue.hpp"
+#include "route_table.hpp"
+#include "session_pool.hpp"
 
 using tcp = net::ip::tcp;
 
-beast::string_view mime_type(
-    beast::string_view path
-);
+// the connections run on strands of their own, the stream keeps the strand's type,
+// so it's operations don't move it to the heap to fit it in an any_io_executor
+using session_executor = net::strand<net::io_context::executor_type>;
+using session_socket = tcp::socket::rebind_executor<session_executor>::other;
+using session_stream = beast::basic_stream<tcp, session_executor>;
+using session_timer =
+    net::basic_waitable_timer<std::chrono::steady_clock, net::wait_traits<std::chrono::steady_clock>, session_executor>;
 
-std::string path_cat(
-    beast::string_view base,
-    beast::string_view path
-);
+// the fields of the responses and the state of their writes are allocated in an arena of their session
+using response_allocator = std::pmr::polymorphic_allocator<char>;
+using response_fields = http::basic_fields<response_allocator>;
 
-const std::array<std::string, 3> indexable_endpoints = { "/", "/view", "/control" };
+template <class Body>
+using arena_response = http::response<Body, response_fields>;
+
+template <class Body>
+arena_response<Body> make_response(http::status status, unsigned int version, response_allocator allocator);
 
 template <class Body, class Allocator>
-http::response<http::string_body> unauthorized_response(
+arena_response<http::string_body> unauthorized_response(
     std::string& nonce,
     const std::string& opaque,
     http::request<Body, http::basic_fields<Allocator>>& req,
     beast::string_view target,
+    response_allocator allocator,
     bool stale = false
 );
 
-bool is_target_single_level(std::string_view target, std::string endpoint_name);
-bool target_starts_with_segment(std::string_view target, std::string endpoint_name);
+// whether the If-None-Match field value lists the entity tag
+bool etag_matches(std::string_view if_none_match, std::string_view etag);
+
+// the page with a script block of the map config and the gate states at the end of it's head,
+// which the page reads instead of requesting them
+std::string embed_bootstrap(
+    std::string_view page,
+    std::string_view map_config,
+    const common_state::gate_snapshot& snapshot
+);
+
+// the stateVersion parameter of the target's query, sent by a page along with the WebSocket upgrade
+std::optional<std::uint64_t> get_state_version(std::string_view target);
+
+// a response with a body sent straight from a file after the header,
+// which is copied by the kernel on Linux
+struct file_response {
+    arena_response<http::empty_body> header;
+    file_range body;
+};
+
+// every kind of response, which are written as they are, without moving them to the heap
+using http_message = std::variant<
+    arena_response<http::string_body>,
+    arena_response<http::empty_body>,
+    arena_response<http::span_body<const char>>
+>;
+
+using http_response = std::variant<http_message, file_response>;
+
+// the requests are parsed into the arena of their session
+using request_allocator = std::pmr::polymorphic_allocator<char>;
+using request_body = http::basic_string_body<char, std::char_traits<char>, request_allocator>;
+using request_parser = http::request_parser<request_body, request_allocator>;
 
 // handle given request by returning an appropriate response
 template <class Body, class Allocator>
-http::message_generator handle_request(
-    beast::string_view doc_root,
+http_response handle_request(
+    const asset_cache& assets,
+    const client_config_cache& client_configs,
+    common_state& comstate,
     http::request<Body, http::basic_fields<Allocator>>&& req,
     std::shared_ptr<auth_table_t> auth_table,
     std::string& nonce,
     std::string& opaque,
-    std::shared_ptr<gc_config> config
+    std::shared_ptr<gc_config> config,
+    response_allocator allocator
 );
 
 class http_session : public std::enable_shared_from_this<http_session> {
-    beast::tcp_stream stream;
+    session_stream stream;
     beast::flat_buffer buffer;
-    std::shared_ptr<const std::string> doc_root;
+    std::shared_ptr<asset_cache> assets;
+    std::shared_ptr<client_config_cache> client_configs;
 
     std::shared_ptr<common_state> comstate;
-    std::shared_ptr<arduino_messenger> arduino_connection;
+    std::shared_ptr<device_pool> devices;
     std::shared_ptr<auth_table_t> auth_table;
 
     // required for digest authentication
     std::shared_ptr<std::string> nonce;
     std::shared_ptr<std::string> opaque;
 
-    // a queue to prevent overload
+    // the most bytes read from a file at once, where it can't be sent by the kernel
+    static constexpr std::size_t file_chunk_size = 64 * 1024;
+
+    struct queued_response {
+        http_message message;
+        // sent after the message, which only has the header then
+        std::optional<file_range> file;
+    };
+
+    // holds the fields of the queued responses and the state of their writes,
+    // and is cleared once they're all written, so a keep-alive connection reuses it as well,
+    // the reading ahead waits for that after a number of responses, so the arena can't grow for good,
+    // it's declared before the queue, so it outlives the responses
+    static constexpr std::size_t response_arena_size = 8192;
+    static constexpr std::size_t response_arena_limit = 64;
+    std::array<std::byte, response_arena_size> response_arena_buffer;
+    std::pmr::monotonic_buffer_resource response_arena{ response_arena_buffer.data(), response_arena_buffer.size() };
+    // the responses made since the arena was cleared
+    std::size_t arena_responses = 0;
+
+    // the requests are read ahead while the responses are written, up to the queue limit,
+    // the response at the front is the one being written
     static constexpr std::size_t queue_limit = 16;
-    std::vector<http::message_generator> response_queue;
+    ring_queue<queued_response, queue_limit> response_queue;
+    // the client finished sending, the connection is closed once the queued responses are written
+    bool read_closed = false;
+    // the next request is read once the responses written meanwhile make room for it
+    bool read_paused = false;
+    // a WebSocket upgrade read ahead waits in the parser until the responses before it are written,
+    // the socket can't be handed over with a write pending on it
+    bool upgrade_pending = false;
+
+    // the rest of the file of the response being written
+    std::optional<file_range> sending_file;
+    std::vector<char> file_buffer;
+    // the connection is closed once the client is idle for longer than idle_timeout,
+    // every request moves the deadline forward, and the timer only waits again when it finds it moved,
+    // so a keep-alive connection doesn't start a wait for every request like the stream's own timeout does
+    static constexpr std::chrono::seconds idle_timeout{ 30 };
+    std::chrono::steady_clock::time_point deadline;
+    session_timer deadline_timer;
+
+    // bounds the waits for the socket to drain while the kernel sends the file,
+    // which the stream's own timeout doesn't cover
+    net::steady_timer file_wait_timer;
 
-    boost::optional<http::request_parser<http::string_body>> parser;
+    // holds the fields and the body of the request being read and the state of the read, and is cleared before the next one,
+    // so a keep-alive connection reuses the same memory for every request,
+    // the requests that don't fit in the buffer continue on the heap
+    static constexpr std::size_t arena_size = 4096;
+    std::array<std::byte, arena_size> arena_buffer;
+    std::pmr::monotonic_buffer_resource arena{ arena_buffer.data(), arena_buffer.size() };
 
-    std::binary_semaphore write_semaphore{ 1 };
+    boost::optional<request_parser> parser;
 
     std::shared_ptr<gc_config> config;
 
 public:
     http_session(
-        tcp::socket&& socket,
-        std::shared_ptr<const std::string> doc_root,
+        session_socket&& socket,
+        std::shared_ptr<asset_cache> assets,
+        std::shared_ptr<client_config_cache> client_configs,
 		std::shared_ptr<common_state> comstate,
-		std::shared_ptr<arduino_messenger> arduino_connection,
+		std::shared_ptr<device_pool> devices,
         std::shared_ptr<auth_table_t> auth_table,
         std::shared_ptr<std::string> opaque,
         std::shared_ptr<std::string> nonce,
         std::shared_ptr<gc_config> config
     );
 
+    ~http_session();
+
     void run();
 
     void do_read();
@@ -117,16 +227,33 @@ public:
         std::size_t bytes_transferred
     );
 
-    void queue_write(http::message_generator msg);
+    void queue_write(http_response response);
 
     void do_close();
 
-    bool do_write();
+    void do_write();
     void on_write(
         bool keep_alive,
         beast::error_code ec,
         std::size_t bytes_transferred
     );
+
+private:
+    bool can_read_ahead() const;
+    // reads the next request, or pauses the reading until there's room for it's response
+    void continue_reading();
+
+    // hands the socket over to a WebSocket session, if the upgrade request in the parser is authenticated
+    void do_upgrade();
+
+    void wait_deadline();
+
+    void do_send_file(bool keep_alive);
+    void on_file_written(
+        bool keep_alive,
+        beast::error_code ec,
+        std::size_t bytes_transferred
+    );
 };
 
 
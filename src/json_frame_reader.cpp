@@ -0,0 +1,84 @@
+#include "json_frame_reader.hpp"
+
+json_frame_reader::json_frame_reader(std::size_t max_frame_size)
+	: max_frame_size(max_frame_size) {}
+
+void json_frame_reader::append(std::string_view data) {
+	buffer.append(data);
+}
+
+std::optional<std::string> json_frame_reader::next_frame() {
+	while (scanned < buffer.size()) {
+		const char c = buffer[scanned];
+
+		// skip everything between the documents
+		if (frame_start == std::string::npos) {
+			if (c == '{' || c == '[') {
+				frame_start = scanned;
+				depth = 1;
+			}
+			scanned++;
+			continue;
+		}
+
+		if (in_string) {
+			if (escaped)            escaped = false;
+			else if (c == '\\')     escaped = true;
+			else if (c == '"')      in_string = false;
+		}
+		else if (c == '"')                  in_string = true;
+		else if (c == '{' || c == '[')      depth++;
+		else if (c == '}' || c == ']')      depth--;
+
+		if (depth == 0) {
+			std::string frame = buffer.substr(frame_start, scanned - frame_start + 1);
+
+			buffer.erase(0, scanned + 1);
+			reset_scan();
+
+			return frame;
+		}
+
+		// a document that's too long is most likely garbage, drop what was scanned of it
+		// and resync on the next one, keeping the data received after it
+		if (scanned - frame_start + 1 > max_frame_size) {
+			dropped++;
+			buffer.erase(0, scanned + 1);
+			reset_scan();
+			continue;
+		}
+
+		scanned++;
+	}
+
+	// nothing but the bytes between the documents was received
+	if (frame_start == std::string::npos) {
+		buffer.clear();
+		scanned = 0;
+	}
+
+	return std::nullopt;
+}
+
+bool json_frame_reader::has_partial_frame() const {
+	return frame_start != std::string::npos;
+}
+
+std::size_t json_frame_reader::take_dropped_count() {
+	const std::size_t result = dropped;
+	dropped = 0;
+	return result;
+}
+
+void json_frame_reader::clear() {
+	buffer.clear();
+	reset_scan();
+}
+
+void json_frame_reader::reset_scan() {
+	scanned = 0;
+	frame_start = std::string::npos;
+	depth = 0;
+	in_string = false;
+	escaped = false;
+}
@@ -0,0 +1,44 @@
+#ifndef JSON_FRAME_READER_HPP
+#define JSON_FRAME_READER_HPP
+
+#include <string>
+#include <string_view>
+#include <optional>
+#include <cstddef>
+
+// splits a stream of concatenated JSON documents (as the firmware sends them)
+// into separate documents, regardless of how the stream was fragmented
+class json_frame_reader {
+	std::size_t max_frame_size;
+
+	std::string buffer;
+	// the scanning state at the end of the buffer
+	std::size_t scanned = 0;
+	std::size_t frame_start = std::string::npos;
+	int depth = 0;
+	bool in_string = false;
+	bool escaped = false;
+
+	std::size_t dropped = 0;
+
+public:
+	explicit json_frame_reader(std::size_t max_frame_size);
+
+	void append(std::string_view data);
+
+	// the next complete document, if there is one
+	std::optional<std::string> next_frame();
+
+	// true if the beginning of a document was received, but not it's end
+	bool has_partial_frame() const;
+
+	// the number of documents dropped for exceeding the maximum size, since the previous call
+	std::size_t take_dropped_count();
+
+	void clear();
+
+private:
+	void reset_scan();
+};
+
+#endif
@@ -4,16 +4,36 @@ std::string json_message::type_to_str(const MessageType& type) {
 	if (type == QueryState)				return "query_state";
 	if (type == QueryStateResult)		return "query_state_result";
 	if (type == ChangeState)			return "change_state";
+	if (type == ChangeStateBatch)		return "change_state_batch";
 	if (type == Availability)			return "availability";
 	if (type == Text)					return "text";
+	if (type == Error)					return "error";
+	if (type == Config)					return "config";
+	if (type == Progress)				return "progress";
+	if (type == ProgressRate)			return "progress_rate";
+	if (type == Busy)					return "busy";
+	if (type == Expired)				return "expired";
+	if (type == Stuck)					return "stuck";
+	if (type == Finished)				return "finished";
+	throw std::invalid_argument("invalid MessageType");
 }
 
 json_message::MessageType json_message::str_to_type(const std::string_view str) {
 	if (str == "query_state")			return QueryState;
 	if (str == "query_state_result")	return QueryStateResult;
 	if (str == "change_state")			return ChangeState;
+	if (str == "change_state_batch")	return ChangeStateBatch;
 	if (str == "availability")			return Availability;
 	if (str == "text")					return Text;
+	if (str == "error")					return Error;
+	if (str == "config")				return Config;
+	if (str == "progress")				return Progress;
+	if (str == "progress_rate")			return ProgressRate;
+	if (str == "busy")					return Busy;
+	if (str == "expired")				return Expired;
+	if (str == "stuck")					return Stuck;
+	if (str == "finished")				return Finished;
+	throw json_message_parse_error("unknown message type");
 }
 
 std::string json_message::create_message(
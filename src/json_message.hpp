@@ -10,8 +10,17 @@ public:
 		QueryState,
 		QueryStateResult,
 		ChangeState,
+		ChangeStateBatch,
 		Availability,
-		Text
+		Text,
+		Error,
+		Config,
+		Progress,
+		ProgressRate,
+		Busy,
+		Expired,
+		Stuck,
+		Finished
 	};
 	
 	class json_message_parse_error : std::runtime_error {
@@ -0,0 +1,207 @@
+#include "link_telemetry.hpp"
+
+void latency_histogram::record(std::chrono::microseconds latency) {
+	std::size_t bucket = 0;
+	for (auto value = latency.count(); value > 0 && bucket < BUCKET_COUNT - 1; value >>= 1) {
+		bucket++;
+	}
+
+	buckets[bucket]++;
+	count++;
+	sum += latency;
+	max = std::max(max, latency);
+}
+
+std::chrono::microseconds latency_histogram::mean() const {
+	if (count == 0) {
+		return std::chrono::microseconds(0);
+	}
+	return sum / count;
+}
+
+std::chrono::microseconds latency_histogram::quantile(double q) const {
+	const auto target = static_cast<std::uint64_t>(q * count);
+
+	std::uint64_t seen = 0;
+	for (std::size_t i = 0; i < BUCKET_COUNT; i++) {
+		seen += buckets[i];
+		if (seen > target || (seen == count && count > 0)) {
+			return std::min(std::chrono::microseconds(1LL << i), max);
+		}
+	}
+
+	return std::chrono::microseconds(0);
+}
+
+nlohmann::json latency_histogram::to_json() const {
+	return {
+		{ "count", count },
+		{ "meanUs", mean().count() },
+		{ "p50Us", quantile(0.5).count() },
+		{ "p99Us", quantile(0.99).count() },
+		{ "maxUs", max.count() },
+		{ "buckets", buckets }
+	};
+}
+
+nlohmann::json link_telemetry::snapshot::to_json() const {
+	nlohmann::json write_json = nlohmann::json::object();
+	for (const auto& [type, histogram] : write_latency) {
+		write_json[type] = histogram.to_json();
+	}
+
+	nlohmann::json ack_json = nlohmann::json::object();
+	for (const auto& [type, histogram] : ack_latency) {
+		ack_json[type] = histogram.to_json();
+	}
+
+	nlohmann::json lane_write_json = nlohmann::json::object();
+	for (const auto& [lane, histogram] : lane_write_latency) {
+		lane_write_json[lane] = histogram.to_json();
+	}
+
+	nlohmann::json lane_ack_json = nlohmann::json::object();
+	for (const auto& [lane, histogram] : lane_ack_latency) {
+		lane_ack_json[lane] = histogram.to_json();
+	}
+
+	return {
+		{ "writeLatency", write_json },
+		{ "ackLatency", ack_json },
+		{ "laneWriteLatency", lane_write_json },
+		{ "laneAckLatency", lane_ack_json },
+		{ "outgoingQueueDepth", outgoing_queue_depth },
+		{ "outgoingQueuePeak", outgoing_queue_peak },
+		{ "incomingQueueDepth", incoming_queue_depth },
+		{ "incomingQueuePeak", incoming_queue_peak },
+		{ "bytesSent", bytes_sent },
+		{ "bytesReceived", bytes_received },
+		{ "bytesSentPerSecond", bytes_sent_per_second },
+		{ "bytesReceivedPerSecond", bytes_received_per_second },
+		{ "byteLatencyNs", byte_latency.count() },
+		{ "byteTransmissionTimeNs", byte_transmission_time.count() },
+		{ "parseFailures", parse_failures },
+		{ "droppedFrames", dropped_frames },
+		{ "unansweredCommands", unanswered_commands },
+		{ "deviceErrors", device_errors },
+		{ "busyRejections", busy_rejections },
+		{ "expiredCommands", expired_commands },
+		{ "reconnects", reconnects },
+		{ "available", available }
+	};
+}
+
+void link_telemetry::record_write(json_message::MessageType type, MessagePriority lane, clock::duration queued_for) {
+	const auto latency = std::chrono::duration_cast<std::chrono::microseconds>(queued_for);
+
+	std::lock_guard lock(mutex);
+	current.write_latency[json_message::type_to_str(type)].record(latency);
+	current.lane_write_latency[priority_to_str(lane)].record(latency);
+}
+
+void link_telemetry::record_ack(json_message::MessageType type, MessagePriority lane, clock::duration latency) {
+	const auto latency_us = std::chrono::duration_cast<std::chrono::microseconds>(latency);
+
+	std::lock_guard lock(mutex);
+	current.ack_latency[json_message::type_to_str(type)].record(latency_us);
+	current.lane_ack_latency[priority_to_str(lane)].record(latency_us);
+}
+
+void link_telemetry::record_outgoing_depth(std::size_t depth) {
+	std::lock_guard lock(mutex);
+	current.outgoing_queue_depth = depth;
+	current.outgoing_queue_peak = std::max(current.outgoing_queue_peak, depth);
+}
+
+void link_telemetry::record_incoming_depth(std::size_t depth) {
+	std::lock_guard lock(mutex);
+	current.incoming_queue_depth = depth;
+	current.incoming_queue_peak = std::max(current.incoming_queue_peak, depth);
+}
+
+void link_telemetry::record_sent(std::size_t bytes) {
+	std::lock_guard lock(mutex);
+	current.bytes_sent += bytes;
+}
+
+void link_telemetry::record_received(std::size_t bytes) {
+	std::lock_guard lock(mutex);
+	current.bytes_received += bytes;
+}
+
+void link_telemetry::record_byte_latency(clock::duration latency) {
+	std::lock_guard lock(mutex);
+
+	const auto sample = std::chrono::duration_cast<std::chrono::nanoseconds>(latency);
+	if (current.byte_latency.count() == 0) {
+		current.byte_latency = sample;
+	}
+	else {
+		// exponential moving average with a weight of 1/8 for the new sample
+		current.byte_latency += (sample - current.byte_latency) / 8;
+	}
+}
+
+void link_telemetry::record_byte_transmission_time(std::chrono::nanoseconds time) {
+	std::lock_guard lock(mutex);
+	current.byte_transmission_time = time;
+}
+
+void link_telemetry::record_parse_failure() {
+	std::lock_guard lock(mutex);
+	current.parse_failures++;
+}
+
+void link_telemetry::record_dropped_frame() {
+	std::lock_guard lock(mutex);
+	current.dropped_frames++;
+}
+
+void link_telemetry::record_unanswered_command() {
+	std::lock_guard lock(mutex);
+	current.unanswered_commands++;
+}
+
+void link_telemetry::record_device_error() {
+	std::lock_guard lock(mutex);
+	current.device_errors++;
+}
+
+void link_telemetry::record_busy_rejection() {
+	std::lock_guard lock(mutex);
+	current.busy_rejections++;
+}
+
+void link_telemetry::record_expired_command() {
+	std::lock_guard lock(mutex);
+	current.expired_commands++;
+}
+
+void link_telemetry::record_availability(bool available) {
+	std::lock_guard lock(mutex);
+	if (available && !current.available) {
+		current.reconnects++;
+	}
+	current.available = available;
+}
+
+link_telemetry::snapshot link_telemetry::take_snapshot() {
+	std::lock_guard lock(mutex);
+
+	const auto now = clock::now();
+	const double seconds = std::chrono::duration<double>(now - previous_time).count();
+
+	snapshot result = current;
+	if (seconds > 0) {
+		result.bytes_sent_per_second = (current.bytes_sent - previous_bytes_sent) / seconds;
+		result.bytes_received_per_second = (current.bytes_received - previous_bytes_received) / seconds;
+	}
+
+	previous_time = now;
+	previous_bytes_sent = current.bytes_sent;
+	previous_bytes_received = current.bytes_received;
+	current.outgoing_queue_peak = current.outgoing_queue_depth;
+	current.incoming_queue_peak = current.incoming_queue_depth;
+
+	return result;
+}
@@ -0,0 +1,119 @@
+#ifndef LINK_TELEMETRY_HPP
+#define LINK_TELEMETRY_HPP
+
+#include <array>
+#include <map>
+#include <mutex>
+#include <chrono>
+#include <string>
+#include <cstdint>
+
+#include <nlohmann/json.hpp>
+
+#include "json_message.hpp"
+#include "message_priority.hpp"
+
+// a histogram of latencies with power-of-two microsecond buckets,
+// bucket i counts the latencies in [2^(i-1), 2^i) us
+class latency_histogram {
+public:
+	// the last bucket holds everything above ~4.2 s
+	static constexpr std::size_t BUCKET_COUNT = 24;
+
+	std::array<std::uint64_t, BUCKET_COUNT> buckets{};
+	std::uint64_t count = 0;
+	std::chrono::microseconds sum{ 0 };
+	std::chrono::microseconds max{ 0 };
+
+	void record(std::chrono::microseconds latency);
+
+	std::chrono::microseconds mean() const;
+	// the upper bound of the bucket holding the given quantile (0..1)
+	std::chrono::microseconds quantile(double q) const;
+
+	nlohmann::json to_json() const;
+};
+
+// counters of a single serial link, safe to update from any thread
+class link_telemetry {
+public:
+	using clock = std::chrono::steady_clock;
+
+	struct snapshot {
+		// command latencies by message type,
+		// from queueing the command to writing it and to the device reporting back on it
+		std::map<std::string, latency_histogram> write_latency;
+		std::map<std::string, latency_histogram> ack_latency;
+		// the same latencies by the lane of the outgoing queue
+		std::map<std::string, latency_histogram> lane_write_latency;
+		std::map<std::string, latency_histogram> lane_ack_latency;
+
+		std::size_t outgoing_queue_depth = 0;
+		std::size_t incoming_queue_depth = 0;
+		// the maximum depths since the previous snapshot
+		std::size_t outgoing_queue_peak = 0;
+		std::size_t incoming_queue_peak = 0;
+
+		std::uint64_t bytes_sent = 0;
+		std::uint64_t bytes_received = 0;
+		// the rates since the previous snapshot
+		double bytes_sent_per_second = 0;
+		double bytes_received_per_second = 0;
+
+		// the measured delay per byte of a message arriving in several reads (moving average),
+		// compared to the time the byte takes on the wire at the configured baud rate
+		std::chrono::nanoseconds byte_latency{ 0 };
+		std::chrono::nanoseconds byte_transmission_time{ 0 };
+
+		std::uint64_t parse_failures = 0;
+		// received messages over the size limit
+		std::uint64_t dropped_frames = 0;
+		// sent commands the device never answered
+		std::uint64_t unanswered_commands = 0;
+		// the errors the device reported, whether or not they answered a command
+		std::uint64_t device_errors = 0;
+		// commands turned away because the link was busy
+		std::uint64_t busy_rejections = 0;
+		// commands dropped for missing their deadline
+		std::uint64_t expired_commands = 0;
+		std::uint64_t reconnects = 0;
+		bool available = true;
+
+		nlohmann::json to_json() const;
+	};
+
+private:
+	mutable std::mutex mutex;
+	snapshot current;
+
+	clock::time_point previous_time = clock::now();
+	std::uint64_t previous_bytes_sent = 0;
+	std::uint64_t previous_bytes_received = 0;
+
+public:
+	void record_write(json_message::MessageType type, MessagePriority lane, clock::duration queued_for);
+	void record_ack(json_message::MessageType type, MessagePriority lane, clock::duration latency);
+
+	void record_outgoing_depth(std::size_t depth);
+	void record_incoming_depth(std::size_t depth);
+
+	void record_sent(std::size_t bytes);
+	void record_received(std::size_t bytes);
+
+	void record_byte_latency(clock::duration latency);
+	void record_byte_transmission_time(std::chrono::nanoseconds time);
+
+	void record_parse_failure();
+	void record_dropped_frame();
+	void record_unanswered_command();
+	void record_device_error();
+	void record_busy_rejection();
+	void record_expired_command();
+
+	void record_availability(bool available);
+
+	// returns the current counters and starts a new interval for the rates and peaks
+	snapshot take_snapshot();
+};
+
+#endif
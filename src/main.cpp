@@ -3,6 +3,7 @@
 #include <vector>
 #include <thread>
 #include <limits>
+#include <functional>
 
 #include <nlohmann/json.hpp>
 
@@ -12,13 +13,15 @@
 
 #include "http_listener.hpp"
 #include "common_state.hpp"
+#include "scheduler.hpp"
+#include "asset_cache.hpp"
+#include "client_config_cache.hpp"
 #include "config.hpp"
 
 using tcp = net::ip::tcp;
 
 const auto DEFAULT_ADDRESS = net::ip::make_address_v4("0.0.0.0");
 const auto DEFAULT_PORT = static_cast<unsigned short>(80);
-const auto DOC_ROOT = std::make_shared<std::string>("./client");
 const auto THREAD_COUNT = 8;
 
 int main(int argc, char* argv[]) {
@@ -100,30 +103,51 @@ int main(int argc, char* argv[]) {
 
     net::io_context ioc{THREAD_COUNT};
 
+	// without any devices in the config, the gates are controlled by a single device on the passed port
+	if (config_ptr->devices.empty()) {
+		config_ptr->devices.push_back(
+			device_entry::make_default(argv[1], config_ptr->get_gate_ids())
+		);
+	}
+
     try {
-		auto arduino_connection =
-			std::make_shared<arduino_messenger>(
+		auto devices =
+			std::make_shared<device_pool>(
 				ioc,
-				argv[1],
-				115200
+				config_ptr->devices
 			);
 
-		arduino_connection->run();
+		devices->run();
 
 		auto comstate = 
 			std::make_shared<common_state>(
 				ioc,
-				arduino_connection
+				devices
 			);
 
 		comstate->run();
 
+		auto assets = std::make_shared<asset_cache>();
+		auto client_configs = std::make_shared<client_config_cache>(config_ptr);
+
+		auto jobs =
+			std::make_shared<scheduler>(
+				ioc,
+				devices,
+				auth_table_ptr,
+				config_ptr,
+				argv[3]
+			);
+
+		jobs->run();
+
 		std::make_shared<http_listener>(
 			ioc,
 			tcp::endpoint{address.value(), port.value()},
-			DOC_ROOT,
+			assets,
+			client_configs,
 			comstate,
-			arduino_connection,
+			devices,
 			auth_table_ptr,
 			config_ptr
 		)->run();
@@ -140,6 +164,21 @@ int main(int argc, char* argv[]) {
 			}
 		);
 
+#ifndef _WIN32
+		// reload the schedule from the config file
+		net::signal_set reload_signals(ioc, SIGHUP);
+		std::function<void(const beast::error_code&, int)> on_reload =
+			[&](const beast::error_code& ec, int) {
+				if (ec) {
+					return;
+				}
+
+				jobs->reload();
+				reload_signals.async_wait(on_reload);
+			};
+		reload_signals.async_wait(on_reload);
+#endif
+
 		std::vector<std::thread> v;
 		v.reserve(THREAD_COUNT - 1);
 		for (auto i = 0; i < THREAD_COUNT - 1; ++i) {
@@ -0,0 +1,24 @@
+#ifndef MESSAGE_PRIORITY_HPP
+#define MESSAGE_PRIORITY_HPP
+
+#include <cstddef>
+
+// the lanes of a device's outgoing queue, from the most to the least urgent
+enum MessagePriority {
+	// commands of the operators
+	Urgent,
+	// state queries of the clients
+	Routine,
+	// queries the server makes on it's own
+	Background
+};
+
+constexpr std::size_t MESSAGE_PRIORITY_COUNT = 3;
+
+inline const char* priority_to_str(MessagePriority priority) {
+	if (priority == Urgent)		return "urgent";
+	if (priority == Routine)	return "routine";
+	return "background";
+}
+
+#endif
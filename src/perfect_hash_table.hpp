@@ -0,0 +1,77 @@
+#ifndef PERFECT_HASH_TABLE_HPP
+#define PERFECT_HASH_TABLE_HPP
+
+#include <array>
+#include <string_view>
+#include <cstdint>
+#include <cstddef>
+#include <bit>
+
+// a lookup table of a fixed set of string keys, built at compile time,
+// where every key has a slot of it's own, so a lookup is a single hash and comparison
+template <std::size_t N>
+class perfect_hash_table {
+public:
+    // twice as many slots as keys keeps the seed search short
+    static constexpr std::size_t SLOT_COUNT = std::bit_ceil(N * 2 > 0 ? N * 2 : 1);
+    static constexpr std::size_t EMPTY_SLOT = N;
+
+private:
+    std::array<std::string_view, N> keys;
+    std::uint32_t seed = 0;
+    // the index of the key in every slot, EMPTY_SLOT if none
+    std::array<std::size_t, SLOT_COUNT> slots{};
+
+public:
+    // the keys have to be unique
+    consteval perfect_hash_table(const std::array<std::string_view, N>& keys) : keys(keys) {
+        // tries seeds until no two keys share a slot
+        while (!try_seed()) {
+            seed++;
+        }
+    }
+
+    // the index of the key in the array the table was built from, N if it isn't there
+    constexpr std::size_t find(std::string_view key) const {
+        const std::size_t index = slots[hash(key, seed) & (SLOT_COUNT - 1)];
+        if (index == EMPTY_SLOT || keys[index] != key) {
+            return N;
+        }
+
+        return index;
+    }
+
+    static constexpr std::uint32_t hash(std::string_view key, std::uint32_t seed) {
+        // FNV-1a, with the seed mixed into the offset basis
+        std::uint32_t value = 2166136261u ^ (seed * 0x9E3779B9u);
+        for (char c : key) {
+            value ^= static_cast<unsigned char>(c);
+            value *= 16777619u;
+        }
+
+        // the low bits of FNV-1a only depend on the low bits of the seed and the key,
+        // so the high bits are mixed into them, or many seeds would hash alike
+        value ^= value >> 16;
+        value *= 0x45D9F3Bu;
+        value ^= value >> 16;
+
+        return value;
+    }
+
+private:
+    constexpr bool try_seed() {
+        slots.fill(EMPTY_SLOT);
+
+        for (std::size_t i = 0; i < N; i++) {
+            std::size_t& slot = slots[hash(keys[i], seed) & (SLOT_COUNT - 1)];
+            if (slot != EMPTY_SLOT) {
+                return false;
+            }
+            slot = i;
+        }
+
+        return true;
+    }
+};
+
+#endif
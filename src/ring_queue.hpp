@@ -0,0 +1,56 @@
+#ifndef RING_QUEUE_HPP
+#define RING_QUEUE_HPP
+
+#include <array>
+#include <optional>
+#include <utility>
+#include <cstddef>
+
+// a first-in first-out queue of at most N elements in a fixed ring of slots,
+// so pushing and popping never allocate or move the other elements
+template <class T, std::size_t N>
+class ring_queue {
+    static_assert(N > 0, "ring queue capacity must be non-zero");
+
+    // the slots are optional, so T doesn't have to be default constructible
+    std::array<std::optional<T>, N> slots;
+    std::size_t head = 0;
+    std::size_t count = 0;
+
+public:
+    // the queue must not be full
+    template <class... Args>
+    T& emplace(Args&&... args) {
+        return slots[(head + count++) % N].emplace(std::forward<Args>(args)...);
+    }
+
+    // the queue must not be empty
+    T& front() {
+        return slots[head].value();
+    }
+
+    // the queue must not be empty
+    void pop() {
+        slots[head].reset();
+        head = (head + 1) % N;
+        count--;
+    }
+
+    std::size_t size() const {
+        return count;
+    }
+
+    bool empty() const {
+        return count == 0;
+    }
+
+    bool full() const {
+        return count == N;
+    }
+
+    static constexpr std::size_t capacity() {
+        return N;
+    }
+};
+
+#endif
@@ -0,0 +1,141 @@
+#include "route_table.hpp"
+
+#include <array>
+#include <algorithm>
+
+#include "perfect_hash_table.hpp"
+
+namespace {
+
+struct route_entry {
+    RouteHandler handler;
+    std::optional<AuthorizationType> permissions;
+    // the page served for the segment itself, empty if it has none
+    std::string_view index_path;
+    // whether the index page gets the map config and the gate states embedded
+    bool has_bootstrap;
+};
+
+// by the first segment of the target
+constexpr std::array<std::string_view, 5> route_segments = {
+    "",
+    "config",
+    "maps",
+    "control",
+    "view"
+};
+
+constexpr std::array<route_entry, route_segments.size()> route_entries = {{
+    { AssetHandler, std::nullopt, "/index.html", false },
+    { ConfigHandler, View, "", false },
+    { MapHandler, View, "", false },
+    { AssetHandler, Control, "/control/index.html", true },
+    { AssetHandler, View, "/view/index.html", true }
+}};
+
+constexpr perfect_hash_table<route_segments.size()> route_table(route_segments);
+
+// the other files are served to anyone
+constexpr route_entry public_asset_entry{ AssetHandler, std::nullopt, "", false };
+
+// the extensions are looked up in lowercase
+constexpr std::array<std::string_view, 21> mime_extensions = {
+    ".htm",
+    ".html",
+    ".php",
+    ".css",
+    ".txt",
+    ".js",
+    ".json",
+    ".xml",
+    ".swf",
+    ".flv",
+    ".png",
+    ".jpe",
+    ".jpeg",
+    ".jpg",
+    ".gif",
+    ".bmp",
+    ".ico",
+    ".tiff",
+    ".tif",
+    ".svg",
+    ".svgz"
+};
+
+constexpr std::array<std::string_view, mime_extensions.size()> mime_types = {
+    "text/html",
+    "text/html",
+    "text/html",
+    "text/css",
+    "text/plain",
+    "application/javascript",
+    "application/json",
+    "application/xml",
+    "application/x-shockwave-flash",
+    "video/x-flv",
+    "image/png",
+    "image/jpeg",
+    "image/jpeg",
+    "image/jpeg",
+    "image/gif",
+    "image/bmp",
+    "image/vnd.microsoft.icon",
+    "image/tiff",
+    "image/tiff",
+    "image/svg+xml",
+    "image/svg+xml"
+};
+
+constexpr perfect_hash_table<mime_extensions.size()> mime_table(mime_extensions);
+
+// longer than every extension in the table
+constexpr std::size_t MAX_EXTENSION_SIZE = 8;
+
+constexpr std::string_view DEFAULT_MIME_TYPE = "application/text";
+
+}
+
+route resolve_route(std::string_view target) {
+    const std::size_t segment_end = std::min(target.find('/', 1), target.size());
+    const std::string_view rest = target.substr(segment_end);
+
+    const std::size_t index = route_table.find(target.substr(1, segment_end - 1));
+    const route_entry& entry = index < route_entries.size() ? route_entries[index] : public_asset_entry;
+
+    const bool is_index =
+        !entry.index_path.empty() &&
+        (rest.empty() || rest == "/");
+
+    return {
+        entry.handler,
+        entry.permissions,
+        rest,
+        is_index ? entry.index_path : target,
+        is_index && entry.has_bootstrap
+    };
+}
+
+std::string_view mime_type(std::string_view path) {
+    // get the extension part of the path (after the last dot)
+    const auto pos = path.rfind('.');
+    if (pos == std::string_view::npos || path.size() - pos > MAX_EXTENSION_SIZE) {
+        return DEFAULT_MIME_TYPE;
+    }
+
+    std::array<char, MAX_EXTENSION_SIZE> extension;
+    const std::size_t size = path.size() - pos;
+    std::transform(
+        path.begin() + pos,
+        path.end(),
+        extension.begin(),
+        [](char c) { return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c; }
+    );
+
+    const std::size_t index = mime_table.find(std::string_view(extension.data(), size));
+    if (index == mime_extensions.size()) {
+        return DEFAULT_MIME_TYPE;
+    }
+
+    return mime_types[index];
+}
@@ -0,0 +1,36 @@
+#ifndef ROUTE_TABLE_HPP
+#define ROUTE_TABLE_HPP
+
+#include <string_view>
+#include <optional>
+
+#include "auth.hpp"
+
+// what serves the request
+enum RouteHandler {
+    ConfigHandler,
+    MapHandler,
+    AssetHandler
+};
+
+struct route {
+    RouteHandler handler;
+    // the least permissions a client needs, nullopt if it doesn't need to be authenticated
+    std::optional<AuthorizationType> permissions;
+    // the part of the target after it's first segment, "/<id>" for a map
+    std::string_view rest;
+    // the client file the target refers to, with the index pages filled in,
+    // ends with a '/' for a directory without an index page in the table
+    std::string_view asset_path;
+    // whether the asset is a page the map config and the gate states are embedded into
+    bool has_bootstrap;
+};
+
+// resolves a target by it's first segment with a single lookup in a table built at compile time,
+// the target has to start with a '/'
+route resolve_route(std::string_view target);
+
+// the MIME type of a file by it's extension
+std::string_view mime_type(std::string_view path);
+
+#endif
@@ -0,0 +1,194 @@
+#include "scheduler.hpp"
+
+#include <chrono>
+
+static std::time_t get_current_time() {
+	return std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+}
+
+static std::tm to_local_time(std::time_t time) {
+	std::tm local{};
+#ifdef _WIN32
+	localtime_s(&local, &time);
+#else
+	localtime_r(&time, &local);
+#endif
+	return local;
+}
+
+scheduler::scheduler(
+	net::io_context& io,
+	std::shared_ptr<device_pool> devices,
+	std::shared_ptr<auth_table_t> auth_table,
+	std::shared_ptr<gc_config> config,
+	fs::path config_path
+) : devices(devices),
+	auth_table(auth_table),
+	config_path(config_path),
+	tick_timer(net::make_strand(io)),
+	dispatcher(devices, config),
+	wheel(get_current_time())
+{
+	set_jobs(config);
+}
+
+void scheduler::run() {
+	net::post(
+		tick_timer.get_executor(),
+		beast::bind_front_handler(
+			&scheduler::do_tick,
+			shared_from_this()
+		)
+	);
+}
+
+void scheduler::reload() {
+	net::post(
+		tick_timer.get_executor(),
+		[self = shared_from_this()]() {
+			std::optional<gc_config> config;
+			try {
+				config = gc_config::open_from_file(self->config_path);
+			}
+			catch (const std::exception& ex) {
+				std::cerr << "Couldn't reload the schedule, the config file is invalid: " << ex.what() << std::endl;
+				return;
+			}
+
+			if (!config) {
+				std::cerr << "Couldn't reload the schedule, the config file can't be opened." << std::endl;
+				return;
+			}
+
+			self->set_jobs(std::make_shared<gc_config>(std::move(config.value())));
+			std::cout << "Reloaded the schedule with " << self->jobs.size() << " jobs." << std::endl;
+		}
+	);
+}
+
+std::optional<std::time_t> scheduler::get_next_run(const schedule_entry& job, std::time_t after) {
+	if (job.every) {
+		return after + job.every.value();
+	}
+
+	if (!job.at) {
+		return std::nullopt;
+	}
+
+	std::tm local = to_local_time(after);
+	local.tm_hour = job.at->hour;
+	local.tm_min = job.at->minute;
+	local.tm_sec = 0;
+
+	if (job.date) {
+		local.tm_year = job.date->year - 1900;
+		local.tm_mon = job.date->month - 1;
+		local.tm_mday = job.date->day;
+		local.tm_isdst = -1;
+
+		const std::time_t time = std::mktime(&local);
+		if (time == -1 || time <= after) {
+			return std::nullopt;
+		}
+		return time;
+	}
+
+	// today or one of the next seven days, mktime normalizes the day of the month
+	for (int day = 0; day <= 7; day++) {
+		std::tm candidate = local;
+		candidate.tm_mday += day;
+		candidate.tm_isdst = -1;
+
+		const std::time_t time = std::mktime(&candidate);
+		if (time == -1 || time <= after) {
+			continue;
+		}
+
+		if (job.weekdays == 0 || (job.weekdays >> candidate.tm_wday) & 1) {
+			return time;
+		}
+	}
+
+	return std::nullopt;
+}
+
+void scheduler::set_jobs(std::shared_ptr<gc_config> config) {
+	jobs = config->schedule;
+	// the scenes the jobs refer to come from the same config
+	dispatcher = command_dispatcher(devices, config);
+
+	const std::time_t now = get_current_time();
+	wheel.reset(now);
+
+	for (std::size_t i = 0; i < jobs.size(); i++) {
+		schedule_job(i, now);
+	}
+}
+
+void scheduler::do_tick() {
+	tick_timer.expires_after(TICK_INTERVAL);
+	tick_timer.async_wait(
+		beast::bind_front_handler(
+			&scheduler::on_tick,
+			shared_from_this()
+		)
+	);
+}
+
+void scheduler::on_tick(const boost::system::error_code& ec) {
+	if (ec) {
+		return;
+	}
+
+	const std::time_t now = get_current_time();
+
+	// if the clock went back, the jobs wait for it to catch up,
+	// if it jumped forward, every overdue job runs once and continues from now
+	for (timer_wheel::timer_id index : wheel.advance(now)) {
+		run_job(index);
+		schedule_job(index, now);
+	}
+
+	do_tick();
+}
+
+void scheduler::run_job(std::size_t index) {
+	const schedule_entry& job = jobs[index];
+
+	const auto user = auth_table->find(job.user);
+	if (user == auth_table->end()) {
+		std::cerr << "Scheduled job '" << job.id << "' has an unknown user '" << job.user << "'." << std::endl;
+		return;
+	}
+
+	const command_origin origin{ user->second.permissions, job.user, user->second.map_groups };
+
+	auto on_dropped = [id = job.id](json_message::MessageType reason, const json_message&) {
+		std::cerr
+			<< "Scheduled job '" << id << "' was dropped: "
+			<< json_message::type_to_str(reason) << std::endl;
+	};
+
+	try {
+		json_message command(
+			json_message::str_to_type(job.command["type"].get<std::string>()),
+			job.command.value("payload", nlohmann::json())
+		);
+
+		if (dispatcher.dispatch(command, origin, on_dropped)) {
+			std::cout << "Ran scheduled job '" << job.id << "'." << std::endl;
+		}
+		else {
+			std::cerr << "Scheduled job '" << job.id << "' isn't allowed for it's user." << std::endl;
+		}
+	}
+	catch (const std::exception& ex) {
+		std::cerr << "Couldn't run scheduled job '" << job.id << "': " << ex.what() << std::endl;
+	}
+}
+
+void scheduler::schedule_job(std::size_t index, std::time_t after) {
+	if (const auto next_run = get_next_run(jobs[index], after)) {
+		wheel.schedule(index, next_run.value());
+	}
+}
@@ -0,0 +1,70 @@
+#ifndef SCHEDULER_HPP
+#define SCHEDULER_HPP
+
+#include "common.hpp"
+
+#include <memory>
+#include <vector>
+#include <optional>
+#include <ctime>
+#include <filesystem>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/strand.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/post.hpp>
+
+#include <boost/beast/core/bind_handler.hpp>
+
+#include "timer_wheel.hpp"
+#include "command_dispatcher.hpp"
+#include "device_pool.hpp"
+#include "config.hpp"
+#include "auth.hpp"
+
+namespace fs = std::filesystem;
+
+// runs the scheduled jobs of the config, sending their commands
+// through the same authorized path as the clients' ones
+class scheduler : public std::enable_shared_from_this<scheduler> {
+	// how often the timer wheel is advanced, which is also it's tick
+	static constexpr std::chrono::seconds TICK_INTERVAL = std::chrono::seconds(1);
+
+	std::shared_ptr<device_pool> devices;
+	std::shared_ptr<auth_table_t> auth_table;
+	// the schedule is read from here again on a reload
+	fs::path config_path;
+
+	// only accessed from the timer's strand
+	net::steady_timer tick_timer;
+	std::vector<schedule_entry> jobs;
+	command_dispatcher dispatcher;
+	// the next run of every job, by it's index, the ticks are seconds since the epoch
+	timer_wheel wheel;
+
+public:
+	scheduler(
+		net::io_context& io,
+		std::shared_ptr<device_pool> devices,
+		std::shared_ptr<auth_table_t> auth_table,
+		std::shared_ptr<gc_config> config,
+		fs::path config_path
+	);
+
+	void run();
+
+	// replaces the jobs with the ones in the config file, keeping the current ones if it's invalid
+	void reload();
+
+	// the first time the job runs after the given one, if it ever does
+	static std::optional<std::time_t> get_next_run(const schedule_entry& job, std::time_t after);
+
+private:
+	void set_jobs(std::shared_ptr<gc_config> config);
+	void do_tick();
+	void on_tick(const boost::system::error_code& ec);
+	void run_job(std::size_t index);
+	void schedule_job(std::size_t index, std::time_t after);
+};
+
+#endif
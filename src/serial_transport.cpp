@@ -0,0 +1,139 @@
+#include "serial_transport.hpp"
+
+#if defined(__linux__)
+#include <termios.h>
+#include <sys/ioctl.h>
+#include <linux/serial.h>
+#include <fstream>
+#include <filesystem>
+#elif !defined(BOOST_ASIO_WINDOWS)
+#include <termios.h>
+#endif
+
+serial_transport::serial_transport(
+	const net::any_io_executor& executor,
+	std::string_view device_name,
+	serial_options options
+) : device_name(device_name),
+	options(options),
+	port(executor),
+	read_buffer(options.read_burst_size) {}
+
+void serial_transport::open(boost::system::error_code& error) {
+	port.open(device_name, error);
+	if (error) {
+		return;
+	}
+
+	port.set_option(
+		net::serial_port_base::baud_rate(options.baud_rate), error
+	);
+	if (error) {
+		return;
+	}
+
+	// enable DTR (Data Terminal Ready) for reading from the COM-port to work
+	port.set_option(
+		net::serial_port_base::flow_control(
+			net::serial_port_base::flow_control::hardware
+		),
+		error
+	);
+	if (error) {
+		return;
+	}
+
+	apply_native_options(error);
+}
+
+void serial_transport::close() {
+	boost::system::error_code ec;
+	port.close(ec);
+}
+
+net::any_io_executor serial_transport::get_executor() {
+	return port.get_executor();
+}
+
+const std::string& serial_transport::get_device_name() const {
+	return device_name;
+}
+
+std::chrono::nanoseconds serial_transport::byte_transmission_time() const {
+	// the config doesn't allow a zero baud rate, but the options can come from elsewhere
+	if (options.baud_rate == 0) {
+		return std::chrono::nanoseconds(0);
+	}
+
+	// a start bit, 8 data bits and a stop bit
+	return std::chrono::nanoseconds(10ULL * 1000000000ULL / options.baud_rate);
+}
+
+std::string_view serial_transport::received_data(std::size_t bytes_transferred) const {
+	return std::string_view(read_buffer.data(), bytes_transferred);
+}
+
+#if defined(BOOST_ASIO_WINDOWS)
+
+void serial_transport::apply_native_options(boost::system::error_code& error) {
+	// the port is already in binary mode, reads are shaped by the driver's settings
+	boost::ignore_unused(error);
+}
+
+#else
+
+void serial_transport::apply_native_options(boost::system::error_code& error) {
+	const int fd = port.native_handle();
+
+	termios tio{};
+	if (tcgetattr(fd, &tio) != 0) {
+		error = boost::system::error_code(errno, boost::system::system_category());
+		return;
+	}
+
+	// VMIN and VTIME aren't set, as they don't affect the reads of asio's non-blocking descriptor
+	if (options.raw) {
+		cfmakeraw(&tio);
+	}
+
+	if (tcsetattr(fd, TCSANOW, &tio) != 0) {
+		error = boost::system::error_code(errno, boost::system::system_category());
+		return;
+	}
+
+#if defined(__linux__)
+	if (!options.low_latency) {
+		return;
+	}
+
+	// not every driver supports the flag (pseudo-terminals don't), so failures are ignored
+	serial_struct serial{};
+	if (ioctl(fd, TIOCGSERIAL, &serial) == 0) {
+		serial.flags |= ASYNC_LOW_LATENCY;
+		ioctl(fd, TIOCSSERIAL, &serial);
+	}
+
+	// USB-serial adapters (FTDI and alike) hold received bytes for up to
+	// their latency timer (16 ms by default) before passing them on
+	namespace fs = std::filesystem;
+
+	std::error_code fs_error;
+	const fs::path tty_name = fs::canonical(device_name, fs_error).filename();
+	if (fs_error) {
+		return;
+	}
+
+	const fs::path latency_timer_path = fs::path("/sys/bus/usb-serial/devices") / tty_name / "latency_timer";
+	if (!fs::exists(latency_timer_path, fs_error)) {
+		return;
+	}
+
+	std::ofstream latency_timer(latency_timer_path);
+	latency_timer << 1;
+	if (!latency_timer) {
+		std::cerr << "Couldn't lower the latency timer of " << device_name << ", run the server with write access to " << latency_timer_path << std::endl;
+	}
+#endif
+}
+
+#endif
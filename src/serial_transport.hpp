@@ -0,0 +1,63 @@
+#ifndef SERIAL_TRANSPORT_HPP
+#define SERIAL_TRANSPORT_HPP
+
+#include "common.hpp"
+
+#include <vector>
+#include <string>
+#include <chrono>
+
+#include <boost/asio/serial_port.hpp>
+#include <boost/asio/write.hpp>
+#include <boost/asio/buffer.hpp>
+
+#include "config.hpp"
+
+// a serial port tuned for low-latency reads of short messages
+class serial_transport {
+	std::string device_name;
+	serial_options options;
+
+	net::serial_port port;
+
+	// a single read never returns more than this buffer holds,
+	// so it's allocated once and reused
+	std::vector<char> read_buffer;
+
+public:
+	serial_transport(
+		const net::any_io_executor& executor,
+		std::string_view device_name,
+		serial_options options
+	);
+
+	void open(boost::system::error_code& error);
+	void close();
+
+	net::any_io_executor get_executor();
+	const std::string& get_device_name() const;
+
+	// the time it takes to transmit a single byte at the configured baud rate (8N1)
+	std::chrono::nanoseconds byte_transmission_time() const;
+
+	template <class ReadHandler>
+	void async_read_some(ReadHandler&& handler) {
+		port.async_read_some(
+			net::buffer(read_buffer),
+			std::forward<ReadHandler>(handler)
+		);
+	}
+
+	// the bytes of the last completed read
+	std::string_view received_data(std::size_t bytes_transferred) const;
+
+	template <class ConstBufferSequence, class WriteHandler>
+	void async_write(const ConstBufferSequence& buffers, WriteHandler&& handler) {
+		net::async_write(port, buffers, std::forward<WriteHandler>(handler));
+	}
+
+private:
+	void apply_native_options(boost::system::error_code& error);
+};
+
+#endif
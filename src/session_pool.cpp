@@ -0,0 +1,38 @@
+#include "session_pool.hpp"
+
+namespace {
+
+std::vector<beast::flat_buffer>& get_free_buffers() {
+    thread_local std::vector<beast::flat_buffer> buffers =
+        [] {
+            std::vector<beast::flat_buffer> buffers;
+            buffers.reserve(SESSION_POOL_SIZE);
+            return buffers;
+        }();
+
+    return buffers;
+}
+
+}
+
+beast::flat_buffer buffer_pool::take() {
+    auto& buffers = get_free_buffers();
+    if (buffers.empty()) {
+        return beast::flat_buffer();
+    }
+
+    beast::flat_buffer buffer = std::move(buffers.back());
+    buffers.pop_back();
+
+    return buffer;
+}
+
+void buffer_pool::give_back(beast::flat_buffer&& buffer) {
+    auto& buffers = get_free_buffers();
+    if (buffers.size() >= SESSION_POOL_SIZE || buffer.capacity() > MAX_BUFFER_CAPACITY) {
+        return;
+    }
+
+    buffer.clear();
+    buffers.push_back(std::move(buffer));
+}
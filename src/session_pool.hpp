@@ -0,0 +1,102 @@
+#ifndef SESSION_POOL_HPP
+#define SESSION_POOL_HPP
+
+#include <vector>
+#include <memory>
+#include <cstddef>
+
+#include "common.hpp"
+
+#include <boost/beast/core/flat_buffer.hpp>
+
+// the most blocks or buffers a thread keeps for the next sessions, the rest are freed
+constexpr std::size_t SESSION_POOL_SIZE = 64;
+
+// how the session blocks of a thread were allocated, to check that a burst of reconnecting clients reuses them
+struct session_pool_stats {
+    // taken from the free list
+    std::size_t reused = 0;
+    // allocated anew, because the free list was empty
+    std::size_t allocated = 0;
+};
+
+inline session_pool_stats& get_session_pool_stats() {
+    thread_local session_pool_stats stats;
+    return stats;
+}
+
+// an allocator keeping the memory of the destroyed objects in a free list of the thread,
+// so when many clients reconnect at once, the new sessions take the memory of the finished ones,
+// meant for std::allocate_shared, which allocates a session along with it's control block
+template <class T>
+class session_pool_allocator {
+    struct free_list {
+        std::vector<T*> blocks;
+
+        free_list() {
+            blocks.reserve(SESSION_POOL_SIZE);
+        }
+
+        ~free_list() {
+            for (T* block : blocks) {
+                std::allocator<T>().deallocate(block, 1);
+            }
+        }
+    };
+
+    static std::vector<T*>& get_free_blocks() {
+        thread_local free_list list;
+        return list.blocks;
+    }
+
+public:
+    using value_type = T;
+
+    session_pool_allocator() = default;
+
+    template <class U>
+    session_pool_allocator(const session_pool_allocator<U>&) {}
+
+    T* allocate(std::size_t n) {
+        auto& blocks = get_free_blocks();
+        if (n == 1 && !blocks.empty()) {
+            T* block = blocks.back();
+            blocks.pop_back();
+            get_session_pool_stats().reused++;
+            return block;
+        }
+
+        get_session_pool_stats().allocated++;
+        return std::allocator<T>().allocate(n);
+    }
+
+    void deallocate(T* block, std::size_t n) {
+        auto& blocks = get_free_blocks();
+        if (n == 1 && blocks.size() < SESSION_POOL_SIZE) {
+            blocks.push_back(block);
+            return;
+        }
+
+        std::allocator<T>().deallocate(block, n);
+    }
+
+    template <class U>
+    bool operator==(const session_pool_allocator<U>&) const {
+        return true;
+    }
+};
+
+// the read buffers of the finished sessions, which keep the capacity they grew to,
+// so the next sessions of the thread don't have to grow theirs again
+class buffer_pool {
+    // a buffer grown by an unusually large message isn't worth keeping
+    static constexpr std::size_t MAX_BUFFER_CAPACITY = 64 * 1024;
+
+public:
+    // an empty buffer, with the capacity of a finished session's one if there's any
+    static beast::flat_buffer take();
+
+    static void give_back(beast::flat_buffer&& buffer);
+};
+
+#endif
@@ -0,0 +1,130 @@
+#include "timer_wheel.hpp"
+
+#include <algorithm>
+
+timer_wheel::timer_wheel(std::uint64_t start_tick) : next_tick(start_tick) {}
+
+void timer_wheel::schedule(timer_id id, std::uint64_t expiry_tick) {
+	insert({ id, expiry_tick });
+	timer_count++;
+}
+
+std::vector<timer_wheel::timer_id> timer_wheel::advance(std::uint64_t tick) {
+	std::vector<timer_id> expired;
+
+	if (tick >= next_tick && tick - next_tick >= MAX_STEPPED_TICKS) {
+		skip_to(tick, expired);
+		return expired;
+	}
+
+	while (next_tick <= tick) {
+		const std::size_t index = next_tick & (SLOT_COUNT - 1);
+
+		// when a level wraps around, the next slot of the level above is due to move down
+		if (index == 0) {
+			std::size_t level = 1;
+			for (; level < LEVEL_COUNT; level++) {
+				const std::size_t level_index = (next_tick >> (SLOT_BITS * level)) & (SLOT_COUNT - 1);
+				cascade(levels[level][level_index]);
+
+				if (level_index != 0) {
+					break;
+				}
+			}
+
+			if (level == LEVEL_COUNT) {
+				cascade(overflow);
+			}
+		}
+
+		std::vector<timer>& slot = levels[0][index];
+		for (const timer& t : slot) {
+			expired.push_back(t.id);
+		}
+		timer_count -= slot.size();
+		slot.clear();
+
+		next_tick++;
+	}
+
+	return expired;
+}
+
+std::uint64_t timer_wheel::get_next_tick() const {
+	return next_tick;
+}
+
+std::size_t timer_wheel::size() const {
+	return timer_count;
+}
+
+void timer_wheel::reset(std::uint64_t start_tick) {
+	for (auto& level : levels) {
+		for (auto& slot : level) {
+			slot.clear();
+		}
+	}
+	overflow.clear();
+
+	next_tick = start_tick;
+	timer_count = 0;
+}
+
+void timer_wheel::insert(timer t) {
+	if (t.expiry_tick < next_tick) {
+		t.expiry_tick = next_tick;
+	}
+
+	const std::uint64_t delta = t.expiry_tick - next_tick;
+
+	// the lowest level whose range reaches the expiry
+	for (std::size_t level = 0; level < LEVEL_COUNT; level++) {
+		if (delta < (std::uint64_t(1) << (SLOT_BITS * (level + 1)))) {
+			const std::size_t index = (t.expiry_tick >> (SLOT_BITS * level)) & (SLOT_COUNT - 1);
+			levels[level][index].push_back(t);
+			return;
+		}
+	}
+
+	overflow.push_back(t);
+}
+
+void timer_wheel::skip_to(std::uint64_t tick, std::vector<timer_id>& expired) {
+	std::vector<timer> timers;
+	timers.reserve(timer_count);
+
+	for (auto& level : levels) {
+		for (auto& slot : level) {
+			timers.insert(timers.end(), slot.begin(), slot.end());
+			slot.clear();
+		}
+	}
+	timers.insert(timers.end(), overflow.begin(), overflow.end());
+	overflow.clear();
+
+	// the slots don't keep the timers sorted, but the expired ones are returned in order
+	std::stable_sort(timers.begin(), timers.end(), [](const timer& a, const timer& b) {
+		return a.expiry_tick < b.expiry_tick;
+	});
+
+	next_tick = tick + 1;
+
+	for (const timer& t : timers) {
+		if (t.expiry_tick <= tick) {
+			expired.push_back(t.id);
+			timer_count--;
+		}
+		else {
+			insert(t);
+		}
+	}
+}
+
+void timer_wheel::cascade(std::vector<timer>& slot) {
+	std::vector<timer> timers;
+	timers.swap(slot);
+
+	for (const timer& t : timers) {
+		insert(t);
+	}
+}
@@ -0,0 +1,62 @@
+#ifndef TIMER_WHEEL_HPP
+#define TIMER_WHEEL_HPP
+
+#include <array>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// a hierarchical timing wheel, which keeps the timers in slots by their expiry tick,
+// so that scheduling a timer and advancing by a tick cost O(1) however many timers there are
+class timer_wheel {
+public:
+	using timer_id = std::uint64_t;
+
+	// every level has 64 slots, each covering 64 times the ticks of the level below,
+	// so the four levels cover 64^4 ticks (~194 days of one second ticks)
+	static constexpr unsigned int SLOT_BITS = 6;
+	static constexpr std::size_t SLOT_COUNT = 1 << SLOT_BITS;
+	static constexpr std::size_t LEVEL_COUNT = 4;
+	// advancing further than this at once goes over the timers instead of over every tick
+	static constexpr std::uint64_t MAX_STEPPED_TICKS = SLOT_COUNT;
+
+private:
+	struct timer {
+		timer_id id;
+		std::uint64_t expiry_tick;
+	};
+
+	std::array<std::array<std::vector<timer>, SLOT_COUNT>, LEVEL_COUNT> levels;
+	// the timers beyond the range of the top level
+	std::vector<timer> overflow;
+
+	// the tick the next advance processes first
+	std::uint64_t next_tick;
+	std::size_t timer_count = 0;
+
+public:
+	explicit timer_wheel(std::uint64_t start_tick = 0);
+
+	// the timers expiring at a tick that already passed expire on the next one
+	void schedule(timer_id id, std::uint64_t expiry_tick);
+
+	// processes every tick up to and including the given one,
+	// returns the timers that expired in order of their expiry,
+	// after a long jump (like a resume from suspend) it costs O(timers) instead of O(ticks)
+	std::vector<timer_id> advance(std::uint64_t tick);
+
+	std::uint64_t get_next_tick() const;
+	std::size_t size() const;
+
+	// removes all timers and restarts at the tick
+	void reset(std::uint64_t start_tick);
+
+private:
+	void insert(timer t);
+	// expires everything due by the tick in one pass and rebuilds the wheel from the tick after it
+	void skip_to(std::uint64_t tick, std::vector<timer_id>& expired);
+	// moves the timers of a higher level's slot down, now that they're closer to expiring
+	void cascade(std::vector<timer>& slot);
+};
+
+#endif
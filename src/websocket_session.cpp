@@ -2,9 +2,16 @@
 
 websocket_session::websocket_session(
     tcp::socket&& socket,
-    std::shared_ptr<arduino_messenger> arduino_connection
+    std::shared_ptr<device_pool> devices,
+    std::shared_ptr<gc_config> config
 ) : ws(std::move(socket)),
-    arduino_connection(arduino_connection) {}
+    buffer(buffer_pool::take()),
+    dispatcher(devices, config) {}
+
+websocket_session::~websocket_session() {
+    // the next session of the thread gets the grown buffer
+    buffer_pool::give_back(std::move(buffer));
+}
 
 void websocket_session::on_accept(beast::error_code ec) {
     if (ec) {
@@ -12,11 +19,15 @@ void websocket_session::on_accept(beast::error_code ec) {
         return;
     }
 
+    accepted = true;
+
     // read the message
     do_read();
-    
-    // attempt to clear the write queue
-    do_write();
+
+    // send the messages queued during the handshake
+    if (!write_queue.empty()) {
+        do_write();
+    }
 }
 
 void websocket_session::do_read() {
@@ -31,31 +42,13 @@ void websocket_session::do_read() {
 }
 
 void websocket_session::do_write() {
-    // if there is something to send, do it
-    if (write_queue.size() > 0) {
-        write_buffer = write_queue.front();
-        write_queue.pop();
-
-        ws.async_write(
-            net::buffer(write_buffer),
-            beast::bind_front_handler(
-                &websocket_session::on_write,
-                shared_from_this()
-            )
-        );
-    }
-    // if there isn't, call this function again asyncronously
-    else {
-        std::this_thread::sleep_for(std::chrono::milliseconds(100));
-
-        net::post(
-            ws.get_executor(),
-            beast::bind_front_handler(
-                &websocket_session::do_write,
-                shared_from_this()
-            )
-        );
-    }
+    ws.async_write(
+        net::buffer(write_queue.front()),
+        beast::bind_front_handler(
+            &websocket_session::on_write,
+            shared_from_this()
+        )
+    );
 }
 
 void websocket_session::on_read(
@@ -96,21 +89,65 @@ void websocket_session::on_write(
         return;
     }
 
-    do_write();
+    write_queue.pop();
+
+    // the session is left to the reads when there's nothing to write, so it ends with the connection
+    if (!write_queue.empty()) {
+        do_write();
+    }
 }
 
 void websocket_session::queue_message(std::string_view message) {
-	write_queue.push(std::string(message));
+    // the messages come from other threads, like the broadcasts of the common state
+    // and the dropped commands reported from the serial port's strand,
+    // so they're queued on the session's strand, where the queue is written from
+    net::post(
+        ws.get_executor(),
+        [self = shared_from_this(), message = std::string(message)]() mutable {
+            self->write_queue.push(std::move(message));
+
+            // only a message queued into an empty queue starts the writes, the others follow it
+            if (self->accepted && self->write_queue.size() == 1) {
+                self->do_write();
+            }
+        }
+    );
+}
+
+unsigned int websocket_session::get_progress_rate() const {
+    return progress_rate;
 }
 
 void websocket_session::handle_message(std::string_view message) {
-    if (permissions == Control) {
-		try {
-			auto parsed_msg = json_message::parse_message(message);
-
-			if (parsed_msg.type == json_message::QueryState || parsed_msg.type == json_message::ChangeState)
-				arduino_connection->send_message(parsed_msg);
-		}
-		catch (...) {}
+    try {
+        auto parsed_msg = json_message::parse_message(message);
+
+        // every client chooses how often it gets the gate positions
+        if (parsed_msg.type == json_message::ProgressRate) {
+            if (parsed_msg.payload.is_number_unsigned()) {
+                progress_rate = std::min(parsed_msg.payload.get<unsigned int>(), MAX_PROGRESS_RATE);
+            }
+            return;
+        }
+
+        auto on_dropped = [weak_self = weak_from_this()](json_message::MessageType reason, const json_message& command) {
+            if (auto self = weak_self.lock())
+                self->report_dropped(reason, command);
+        };
+
+        dispatcher.dispatch(parsed_msg, origin, on_dropped);
     }
+    catch (...) {}
+}
+
+void websocket_session::report_dropped(json_message::MessageType reason, const json_message& command) {
+    queue_message(
+        json_message(
+            reason,
+            {
+                { "type", json_message::type_to_str(command.type) },
+                { "payload", command.payload }
+            }
+        ).dump_message()
+    );
 }
\ No newline at end of file
@@ -6,6 +6,7 @@
 #include <memory>
 #include <queue>
 #include <thread>
+#include <atomic>
 
 #include <boost/beast/websocket/stream_base.hpp>
 #include <boost/beast/websocket/stream.hpp>
@@ -20,25 +21,39 @@
 #include <boost/asio/ip/tcp.hpp>
 
 #include "json_message.hpp"
-#include "arduino_messenger.hpp"
+#include "device_pool.hpp"
+#include "command_dispatcher.hpp"
+#include "config.hpp"
 #include "auth.hpp"
+#include "session_pool.hpp"
 
 using tcp = net::ip::tcp;
 
 class websocket_session : public std::enable_shared_from_this<websocket_session> {
+    // the most gate position updates per second a client can ask for
+    static constexpr unsigned int MAX_PROGRESS_RATE = 50;
+
     websocket::stream<beast::tcp_stream> ws;
     beast::flat_buffer buffer;
-    std::string write_buffer;
+    // the message being written stays at the front until it's written
     std::queue<std::string> write_queue;
-    std::shared_ptr<arduino_messenger> arduino_connection;
-    AuthorizationType permissions = Blocked;
+    // the messages queued before the handshake wait for it
+    bool accepted = false;
+    command_dispatcher dispatcher;
+    // the authenticated user the commands come from
+    command_origin origin;
+    // gate position updates per second requested by the client, 0 if it doesn't want them
+    std::atomic<unsigned int> progress_rate = 0;
 
 public:
     explicit websocket_session(
         tcp::socket&& socket,
-		std::shared_ptr<arduino_messenger> arduino_connection
+		std::shared_ptr<device_pool> devices,
+        std::shared_ptr<gc_config> config
     );
 
+    ~websocket_session();
+
     template<class Body, class Allocator>
     void do_accept(
         http::request<Body, http::basic_fields<Allocator>> req,
@@ -51,7 +66,9 @@ public:
             return;
         }
 
-        permissions = auth->permissions;
+        origin.permissions = auth->permissions;
+        origin.username = parse_digest_auth_field(std::string(req.at(http::field::authorization)))->username;
+        origin.map_groups = auth->map_groups;
 
         ws.set_option(
             websocket::stream_base::timeout::suggested(
@@ -77,8 +94,11 @@ public:
         );
     }
 
+    // can be called from any thread
     void queue_message(std::string_view message);
 
+    unsigned int get_progress_rate() const;
+
 private:
     void on_accept(beast::error_code ec);
     void do_write();
@@ -87,6 +107,8 @@ private:
     void on_read(beast::error_code ec, std::size_t bytes_transferred);
 
     void handle_message(std::string_view message);
+    // tells the client that the command won't reach the device, because it was turned away or went stale
+    void report_dropped(json_message::MessageType reason, const json_message& command);
 };
 
 #endif
\ No newline at end of file
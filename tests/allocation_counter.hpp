@@ -0,0 +1,51 @@
+#ifndef ALLOCATION_COUNTER_HPP
+#define ALLOCATION_COUNTER_HPP
+
+#include <atomic>
+#include <new>
+#include <cstdlib>
+#include <cstddef>
+
+// replaces the global operator new to count the heap allocations of the threads that ask for it,
+// the operators can't be inline, so only one file of a test program may include this
+
+inline std::atomic<std::size_t> counted_allocations = 0;
+// the other threads allocate as they like
+inline thread_local bool is_counting_allocations = false;
+
+void* counted_allocate(std::size_t size) {
+	if (is_counting_allocations) {
+		counted_allocations++;
+	}
+
+	if (void* p = std::malloc(size == 0 ? 1 : size)) {
+		return p;
+	}
+	throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size) {
+	return counted_allocate(size);
+}
+
+void* operator new[](std::size_t size) {
+	return counted_allocate(size);
+}
+
+void operator delete(void* p) noexcept {
+	std::free(p);
+}
+
+void operator delete[](void* p) noexcept {
+	std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+	std::free(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept {
+	std::free(p);
+}
+
+#endif
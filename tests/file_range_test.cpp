@@ -0,0 +1,212 @@
+// Checks how the Range field values are interpreted, then asks a server on the loopback for parts of a map image,
+// like a client resuming a download, with a current and a stale If-Range.
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <memory>
+#include <thread>
+#include <filesystem>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/beast/http/read.hpp>
+#include <boost/beast/http/write.hpp>
+#include <boost/beast/http/string_body.hpp>
+#include <boost/beast/core/flat_buffer.hpp>
+
+#include "http_listener.hpp"
+#include "file_range.hpp"
+#include "auth.hpp"
+
+#include "test_common.hpp"
+
+const std::string USERNAME = "tester";
+const std::string PASSWORD = "secret";
+const std::string REALM = "viewcontrol";
+
+const std::string MAP_TARGET = "/maps/floor";
+
+bool is_range(RangeResult result, const byte_range& range, std::uint64_t first, std::uint64_t last) {
+	return result == PartialFile && range.first == first && range.last == last;
+}
+
+void check_parse_range() {
+	byte_range range{};
+
+	check(is_range(parse_range("bytes=0-99", 1000, range), range, 0, 99), "a closed range is kept");
+	check(is_range(parse_range("bytes=500-", 1000, range), range, 500, 999), "an open range goes to the end");
+	check(is_range(parse_range("bytes=-100", 1000, range), range, 900, 999), "a suffix range is the last bytes");
+	check(is_range(parse_range("bytes=-5000", 1000, range), range, 0, 999), "a suffix longer than the file is the whole file");
+	check(is_range(parse_range("bytes=900-5000", 1000, range), range, 900, 999), "a range past the end is cut at it");
+	check(is_range(parse_range("bytes= 10-20 ", 1000, range), range, 10, 20), "the whitespace around a range is skipped");
+
+	check(parse_range("bytes=1000-", 1000, range) == UnsatisfiableRange, "a range starting at the end can't be satisfied");
+	check(parse_range("bytes=-0", 1000, range) == UnsatisfiableRange, "an empty suffix can't be satisfied");
+	check(parse_range("bytes=-10", 0, range) == UnsatisfiableRange, "an empty file has no suffix");
+
+	check(parse_range("items=0-99", 1000, range) == WholeFile, "another unit gets the whole file");
+	check(parse_range("bytes=0-9,20-29", 1000, range) == WholeFile, "several ranges get the whole file");
+	check(parse_range("bytes=20-10", 1000, range) == WholeFile, "a reversed range gets the whole file");
+	check(parse_range("bytes=a-10", 1000, range) == WholeFile, "a range that isn't a number gets the whole file");
+	check(parse_range("bytes=10", 1000, range) == WholeFile, "a range without a dash gets the whole file");
+}
+
+std::string get_quoted_parameter(const std::string& field, const std::string& key) {
+	const std::size_t start = field.find(key + "=\"") + key.size() + 2;
+	return field.substr(start, field.find('"', start) - start);
+}
+
+http::response<http::string_body> get_map(
+	tcp::socket& socket,
+	beast::flat_buffer& buffer,
+	const std::string& authorization,
+	std::string_view range = {},
+	std::string_view if_range = {}
+) {
+	http::request<http::empty_body> req{ http::verb::get, MAP_TARGET, 11 };
+	req.set(http::field::host, "localhost");
+	if (!authorization.empty()) {
+		req.set(http::field::authorization, authorization);
+	}
+	if (!range.empty()) {
+		req.set(http::field::range, range);
+	}
+	if (!if_range.empty()) {
+		req.set(http::field::if_range, if_range);
+	}
+	http::write(socket, req);
+
+	http::response<http::string_body> res;
+	http::read(socket, buffer, res);
+	return res;
+}
+
+// the map needs the view permission, the nonce of the challenge is the one of the client's address
+std::string make_authorization(const tcp::endpoint& endpoint) {
+	net::io_context io;
+	tcp::socket socket(io);
+	socket.connect(endpoint);
+	beast::flat_buffer buffer;
+
+	const auto challenge = get_map(socket, buffer, {});
+	const std::string field(challenge[http::field::www_authenticate]);
+	const std::string nonce = get_quoted_parameter(field, "nonce");
+	const std::string opaque = get_quoted_parameter(field, "opaque");
+
+	const std::string nc = "00000001";
+	const std::string cnonce = "0a4f113b";
+
+	const std::string ha1 = sha256_hash(USERNAME + ':' + REALM + ':' + PASSWORD);
+	const std::string ha2 = sha256_hash("GET:" + MAP_TARGET);
+	const std::string response = sha256_hash(ha1 + ':' + nonce + ':' + nc + ':' + cnonce + ":auth:" + ha2);
+
+	return
+		"Digest username=\"" + USERNAME + "\", realm=\"" + REALM + "\", "
+		"nonce=\"" + nonce + "\", uri=\"" + MAP_TARGET + "\", "
+		"qop=auth, nc=" + nc + ", cnonce=\"" + cnonce + "\", "
+		"response=\"" + response + "\", opaque=\"" + opaque + "\"";
+}
+
+void check_range_requests(const tcp::endpoint& endpoint, const std::string& image) {
+	const std::string authorization = make_authorization(endpoint);
+
+	net::io_context io;
+	tcp::socket socket(io);
+	socket.connect(endpoint);
+	beast::flat_buffer buffer;
+
+	const auto whole = get_map(socket, buffer, authorization);
+	check(whole.result() == http::status::ok, "the map is sent");
+	check(whole.body() == image, "the whole map is sent");
+	check(std::string(whole[http::field::accept_ranges]) == "bytes", "the map's response offers ranges");
+
+	const std::string etag(whole[http::field::etag]);
+	check(!etag.empty(), "the map has an entity tag");
+
+	// the client got the first part of the map and resumes with the rest
+	const auto rest = get_map(socket, buffer, authorization, "bytes=1000-", etag);
+	check(rest.result() == http::status::partial_content, "a range of a current map is partial content");
+	check(rest.body() == image.substr(1000), "the rest of the map is sent");
+	check(
+		std::string(rest[http::field::content_range]) == "bytes 1000-" + std::to_string(image.size() - 1) + "/" + std::to_string(image.size()),
+		"the partial content has it's range"
+	);
+
+	const auto suffix = get_map(socket, buffer, authorization, "bytes=-10");
+	check(suffix.result() == http::status::partial_content, "a suffix range is partial content");
+	check(suffix.body() == image.substr(image.size() - 10), "the last bytes of the map are sent");
+
+	const auto stale = get_map(socket, buffer, authorization, "bytes=1000-", "\"stale\"");
+	check(stale.result() == http::status::ok, "a range of a changed map gets the whole map");
+	check(stale.body() == image, "the whole changed map is sent");
+
+	const auto unsatisfiable = get_map(socket, buffer, authorization, "bytes=" + std::to_string(image.size()) + "-");
+	check(unsatisfiable.result() == http::status::range_not_satisfiable, "a range past the end can't be satisfied");
+	check(
+		std::string(unsatisfiable[http::field::content_range]) == "bytes */" + std::to_string(image.size()),
+		"the unsatisfiable range's response has the map's size"
+	);
+	check(unsatisfiable.body().empty(), "an unsatisfiable range has no body");
+
+	beast::error_code ec;
+	socket.shutdown(tcp::socket::shutdown_both, ec);
+}
+
+int main() {
+	check_parse_range();
+
+	// an image bigger than a socket buffer, so the sending waits for the client
+	std::string image;
+	for (int i = 0; image.size() < 4 * 1024 * 1024; i++) {
+		image += std::to_string(i) + ',';
+	}
+
+	const fs::path image_path = fs::temp_directory_path() / "gate_control_file_range_test.png";
+	{
+		std::ofstream file(image_path, std::ios::binary);
+		file << image;
+	}
+
+	net::io_context io;
+
+	// the listener binds to the port it's given, so a free one is looked up first
+	tcp::endpoint endpoint;
+	{
+		tcp::acceptor probe(io, tcp::endpoint(net::ip::make_address("127.0.0.1"), 0));
+		endpoint = probe.local_endpoint();
+	}
+
+	auto config = std::make_shared<gc_config>(
+		std::initializer_list<map_entry>{ map_entry("floor", std::nullopt, image_path.string(), nlohmann::json::array()) }
+	);
+	auto devices = std::make_shared<device_pool>(io, config->devices);
+
+	auto auth_table = std::make_shared<auth_table_t>();
+	auth_table->insert({ USERNAME, auth_data(View, {}, PASSWORD) });
+
+	std::make_shared<http_listener>(
+		io,
+		endpoint,
+		std::make_shared<asset_cache>(),
+		std::make_shared<client_config_cache>(config),
+		std::make_shared<common_state>(io, devices),
+		devices,
+		auth_table,
+		config
+	)->run();
+
+	std::thread server_thread([&io] {
+		auto work = net::make_work_guard(io);
+		io.run();
+	});
+
+	check_range_requests(endpoint, image);
+
+	io.stop();
+	server_thread.join();
+
+	std::error_code ec;
+	fs::remove(image_path, ec);
+
+	return test_result();
+}
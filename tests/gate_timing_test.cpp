@@ -0,0 +1,92 @@
+// Checks the firmware's gate scheduler on the host: the gates are advanced by the elapsed millis(),
+// so a gate takes the same time to move however many gates move along with it,
+// and a pass over all the gates doesn't hold up the serial commands.
+
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <climits>
+
+#include "gate.h"
+
+#include "test_common.hpp"
+
+// as in gate.h and gate_control.ino
+const unsigned long TRAVEL_TIME = 1000;
+const unsigned int MAX_GATES = 32;
+
+// the time a command to move takes to take effect, on the real board that's the next PWM write
+const auto MAX_PASS_TIME = std::chrono::microseconds(1000);
+
+// raises the gates at the start and ticks them every step until they're all raised,
+// returns the millis() value they finished at
+unsigned long raise_all(unsigned int gate_count, unsigned long start, unsigned long step) {
+	std::vector<Gate> gates(gate_count);
+	for (Gate& gate : gates) {
+		gate.raise(start);
+	}
+
+	unsigned long now = start;
+	unsigned int raised = 0;
+	while (raised < gate_count && now - start < TRAVEL_TIME * 10) {
+		now += step;
+		raised = 0;
+
+		for (Gate& gate : gates) {
+			gate.tick(now);
+			if (gate.get_state() == Raised) {
+				raised++;
+			}
+		}
+	}
+
+	return now;
+}
+
+int main() {
+	// the travel time doesn't depend on how many gates move
+	const unsigned long single_time = raise_all(1, 0, 1);
+	const unsigned long all_time = raise_all(MAX_GATES, 0, 1);
+	// the float position can fall short of the end by a rounding error, which takes another millisecond
+	check(single_time >= TRAVEL_TIME && single_time <= TRAVEL_TIME + 1, "a gate is raised in the travel time");
+	check(all_time == single_time, "all the gates are raised in the same time as one");
+
+	// nor on how often the loop gets to tick them, up to a tick of overshoot
+	const unsigned long slow_loop_time = raise_all(MAX_GATES, 0, 7);
+	check(slow_loop_time >= TRAVEL_TIME && slow_loop_time <= TRAVEL_TIME + 7, "a slow loop doesn't slow the gates down");
+
+	// nor on millis() overflowing while they move
+	const unsigned long start = ULONG_MAX - TRAVEL_TIME / 2;
+	check(raise_all(MAX_GATES, start, 1) - start == single_time, "the gates move through a millis() overflow");
+
+	// a command takes effect right away, and the next tick already moves the gate
+	Gate gate;
+	gate.raise(100);
+	check(gate.get_state() == Raising, "a raised gate starts raising immediately");
+	check(gate.tick(101) && gate.state > 0.0F, "the next tick moves the gate");
+
+	gate.lower(200);
+	check(gate.get_state() == Lowering, "a gate changes direction immediately");
+
+	// a pass over all the moving gates is a few arithmetic operations per gate, never a wait
+	std::vector<Gate> gates(MAX_GATES);
+	for (Gate& g : gates) {
+		g.raise(0);
+	}
+
+	const unsigned long passes = 500;
+	const auto pass_start = std::chrono::steady_clock::now();
+	for (unsigned long now = 1; now <= passes; now++) {
+		for (Gate& g : gates) {
+			g.tick(now);
+		}
+	}
+	const auto pass_time = (std::chrono::steady_clock::now() - pass_start) / passes;
+
+	std::cout
+		<< "A pass over " << MAX_GATES << " moving gates takes "
+		<< std::chrono::duration_cast<std::chrono::nanoseconds>(pass_time).count() << " ns." << std::endl;
+	check(pass_time < MAX_PASS_TIME, "a pass over the moving gates takes less than a millisecond");
+
+	return test_result();
+}
@@ -0,0 +1,97 @@
+// Counts the heap allocations a keep-alive connection makes once it's warmed up,
+// the requests and the responses are built in the session's arenas, so answering one doesn't allocate.
+
+#include <iostream>
+#include <string>
+#include <memory>
+#include <thread>
+#include <chrono>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/strand.hpp>
+#include <boost/asio/connect.hpp>
+#include <boost/beast/http/read.hpp>
+#include <boost/beast/http/write.hpp>
+#include <boost/beast/http/string_body.hpp>
+#include <boost/beast/core/flat_buffer.hpp>
+
+#include "http_session.hpp"
+
+#include "test_common.hpp"
+#include "allocation_counter.hpp"
+
+const int WARMUP_REQUESTS = 32;
+const int MEASURED_REQUESTS = 200;
+
+// a keep-alive request for the page, which is a public asset
+void get_page(tcp::socket& socket, beast::flat_buffer& buffer) {
+	http::request<http::empty_body> req{ http::verb::get, "/", 11 };
+	req.set(http::field::host, "localhost");
+	http::write(socket, req);
+
+	http::response<http::string_body> res;
+	http::read(socket, buffer, res);
+
+	check(res.result() == http::status::ok, "the page is served");
+}
+
+int main() {
+	net::io_context io;
+
+	tcp::acceptor acceptor(io, tcp::endpoint(net::ip::make_address("127.0.0.1"), 0));
+
+	tcp::socket client(io);
+	client.connect(acceptor.local_endpoint());
+
+	auto config = std::make_shared<gc_config>();
+	auto devices = std::make_shared<device_pool>(io, config->devices);
+
+	std::make_shared<http_session>(
+		acceptor.accept(net::make_strand(io)),
+		std::make_shared<asset_cache>(),
+		std::make_shared<client_config_cache>(config),
+		std::make_shared<common_state>(io, devices),
+		devices,
+		std::make_shared<auth_table_t>(),
+		std::make_shared<std::string>("opaque"),
+		std::make_shared<std::string>("nonce"),
+		config
+	)->run();
+
+	std::thread server_thread([&io] {
+		// only the allocations of the server's thread are counted
+		is_counting_allocations = true;
+		io.run();
+	});
+
+	beast::flat_buffer buffer;
+
+	// the first requests fill the caches of asio's handler memory and grow the session's buffer
+	for (int i = 0; i < WARMUP_REQUESTS; i++) {
+		get_page(client, buffer);
+	}
+
+	counted_allocations = 0;
+
+	for (int i = 0; i < MEASURED_REQUESTS; i++) {
+		get_page(client, buffer);
+	}
+
+	// the session goes on to read the next request after the last response
+	std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	const std::size_t allocations = counted_allocations;
+
+	std::cout
+		<< MEASURED_REQUESTS << " requests on a warm keep-alive connection made "
+		<< allocations << " allocations on the server." << std::endl;
+	check(allocations == 0, "answering a request doesn't allocate");
+
+	beast::error_code ec;
+	client.shutdown(tcp::socket::shutdown_both, ec);
+	client.close(ec);
+
+	io.stop();
+	server_thread.join();
+
+	return test_result();
+}
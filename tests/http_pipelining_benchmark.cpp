@@ -0,0 +1,107 @@
+// Measures the throughput of a keep-alive connection whose client pipelines it's requests,
+// sending a batch of them at once and reading the responses after, which are written in order.
+
+#include <iostream>
+#include <string>
+#include <memory>
+#include <thread>
+#include <chrono>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/strand.hpp>
+#include <boost/asio/write.hpp>
+#include <boost/beast/http/read.hpp>
+#include <boost/beast/http/string_body.hpp>
+#include <boost/beast/core/flat_buffer.hpp>
+
+#include "http_session.hpp"
+
+#include "test_common.hpp"
+
+// more than the session's queue limit, so it has to pause and resume reading ahead
+const int PIPELINE_DEPTH = 32;
+const int WARMUP_BATCHES = 4;
+const int MEASURED_BATCHES = 500;
+
+// sends a batch of keep-alive requests for the page in one write, then reads all of the responses,
+// returns the number of responses that were the page
+int get_pages(tcp::socket& socket, beast::flat_buffer& buffer, const std::string& batch) {
+	net::write(socket, net::buffer(batch));
+
+	int pages = 0;
+	for (int i = 0; i < PIPELINE_DEPTH; i++) {
+		http::response<http::string_body> res;
+		http::read(socket, buffer, res);
+
+		if (res.result() == http::status::ok && !res.body().empty()) {
+			pages++;
+		}
+	}
+
+	return pages;
+}
+
+int main() {
+	net::io_context io;
+
+	tcp::acceptor acceptor(io, tcp::endpoint(net::ip::make_address("127.0.0.1"), 0));
+
+	tcp::socket client(io);
+	client.connect(acceptor.local_endpoint());
+
+	auto config = std::make_shared<gc_config>();
+	auto devices = std::make_shared<device_pool>(io, config->devices);
+
+	std::make_shared<http_session>(
+		acceptor.accept(net::make_strand(io)),
+		std::make_shared<asset_cache>(),
+		std::make_shared<client_config_cache>(config),
+		std::make_shared<common_state>(io, devices),
+		devices,
+		std::make_shared<auth_table_t>(),
+		std::make_shared<std::string>("opaque"),
+		std::make_shared<std::string>("nonce"),
+		config
+	)->run();
+
+	// a single io thread, like a server on a one-core device, which must not block on a pipelined response
+	std::thread server_thread([&io] {
+		io.run();
+	});
+
+	std::string batch;
+	for (int i = 0; i < PIPELINE_DEPTH; i++) {
+		batch += "GET / HTTP/1.1\r\nHost: localhost\r\n\r\n";
+	}
+
+	beast::flat_buffer buffer;
+
+	for (int i = 0; i < WARMUP_BATCHES; i++) {
+		get_pages(client, buffer, batch);
+	}
+
+	int pages = 0;
+	const auto start = std::chrono::steady_clock::now();
+
+	for (int i = 0; i < MEASURED_BATCHES; i++) {
+		pages += get_pages(client, buffer, batch);
+	}
+
+	const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	const int requests = MEASURED_BATCHES * PIPELINE_DEPTH;
+
+	std::cout
+		<< requests << " requests pipelined " << PIPELINE_DEPTH << " at a time took "
+		<< elapsed.count() << " s, "
+		<< static_cast<long long>(requests / elapsed.count()) << " requests/s." << std::endl;
+	check(pages == requests, "every pipelined request is answered with the page, in order");
+
+	beast::error_code ec;
+	client.shutdown(tcp::socket::shutdown_both, ec);
+	client.close(ec);
+
+	io.stop();
+	server_thread.join();
+
+	return test_result();
+}
@@ -0,0 +1,83 @@
+// Times the route and MIME type lookups of every request over the kinds of targets the clients ask for,
+// the tables are built at compile time and the lookups work on views of the target, so they don't allocate.
+
+#include <iostream>
+#include <array>
+#include <string_view>
+#include <chrono>
+
+#include "route_table.hpp"
+
+#include "test_common.hpp"
+#include "allocation_counter.hpp"
+
+const int ROUNDS = 200000;
+
+const std::array<std::string_view, 12> TARGETS = {
+	"/",
+	"/control/",
+	"/view",
+	"/config",
+	"/maps/1",
+	"/maps/garage-north",
+	"/styles.3f2a9c1b7d8e0a45.css",
+	"/control/app.0123456789abcdef.js",
+	"/favicon.ico",
+	"/photo.JPG",
+	"/export.tar.xz",
+	"/LICENSE"
+};
+
+void check_routes() {
+	const route page = resolve_route("/control/");
+	check(page.handler == AssetHandler, "/control/ is an asset");
+	check(page.asset_path == "/control/index.html", "/control/ is served it's index page");
+	check(page.has_bootstrap, "the control page gets the bootstrap");
+	check(page.permissions == Control, "the control page needs the control permission");
+
+	const route map = resolve_route("/maps/garage-north");
+	check(map.handler == MapHandler, "/maps/<id> is a map");
+	check(map.rest == "/garage-north", "the map's id is the rest of the target");
+
+	const route asset = resolve_route("/styles.3f2a9c1b7d8e0a45.css");
+	check(asset.handler == AssetHandler && !asset.permissions, "a hashed asset is public");
+	check(asset.asset_path == "/styles.3f2a9c1b7d8e0a45.css", "a hashed asset is served by it's path");
+
+	check(mime_type("/styles.3f2a9c1b7d8e0a45.css") == "text/css", "a hashed stylesheet is text/css");
+	check(mime_type("/photo.JPG") == "image/jpeg", "the extensions are matched in any case");
+	check(mime_type("/export.tar.xz") == "application/text", "an unknown extension gets the default type");
+	check(mime_type("/LICENSE") == "application/text", "a path without an extension gets the default type");
+}
+
+int main() {
+	check_routes();
+
+	// keeps the compiler from dropping the lookups
+	std::size_t checksum = 0;
+
+	counted_allocations = 0;
+	is_counting_allocations = true;
+	const auto start = std::chrono::steady_clock::now();
+
+	for (int i = 0; i < ROUNDS; i++) {
+		for (std::string_view target : TARGETS) {
+			const route r = resolve_route(target);
+			checksum += r.asset_path.size() + r.rest.size();
+			checksum += mime_type(r.asset_path).size();
+		}
+	}
+
+	const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+	is_counting_allocations = false;
+
+	const std::size_t targets = ROUNDS * TARGETS.size();
+	const std::size_t allocations = counted_allocations;
+
+	std::cout
+		<< "Routing " << targets << " targets and looking up their MIME types took "
+		<< elapsed.count() / targets << " ns per target and made "
+		<< allocations << " allocations (checksum " << checksum << ")." << std::endl;
+	check(allocations == 0, "looking up a route and a MIME type doesn't allocate");
+
+	return test_result();
+}
@@ -0,0 +1,226 @@
+// Replugs a device while the server is connected to it and measures how long the server
+// takes to resync it, with a pseudo-terminal standing in for the board.
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <chrono>
+#include <optional>
+#include <filesystem>
+#include <cstring>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/executor_work_guard.hpp>
+
+#include "arduino_messenger.hpp"
+#include "json_frame_reader.hpp"
+#include "json_message.hpp"
+
+#include "test_common.hpp"
+
+using namespace std::chrono_literals;
+using test_clock = std::chrono::steady_clock;
+
+// the server retries with a doubling delay, so a device that was away for a while
+// is found again within the delay of the last failed attempt
+const auto UNPLUGGED_TIME = 600ms;
+const auto MAX_RECOVERY_TIME = 1500ms;
+const auto RECEIVE_TIMEOUT = 3s;
+
+// the board's end of a pseudo-terminal, with the other end reachable at a fixed path like a device node
+class fake_device {
+	int master_fd = -1;
+	std::string link_path;
+	json_frame_reader reader{ 10240 };
+
+public:
+	explicit fake_device(std::string link_path) : link_path(std::move(link_path)) {
+		master_fd = posix_openpt(O_RDWR | O_NOCTTY);
+		if (master_fd < 0 || grantpt(master_fd) != 0 || unlockpt(master_fd) != 0) {
+			throw std::runtime_error(std::string("couldn't open a pseudo-terminal: ") + std::strerror(errno));
+		}
+
+		unlink(this->link_path.c_str());
+		if (symlink(ptsname(master_fd), this->link_path.c_str()) != 0) {
+			throw std::runtime_error(std::string("couldn't link the pseudo-terminal: ") + std::strerror(errno));
+		}
+	}
+
+	~fake_device() {
+		unplug();
+	}
+
+	// the server sees the port fail, and can't open it again until a new device is plugged in
+	void unplug() {
+		if (master_fd < 0) {
+			return;
+		}
+
+		unlink(link_path.c_str());
+		close(master_fd);
+		master_fd = -1;
+	}
+
+	// writes a message like the board would answer
+	void send(const json_message& message) {
+		const std::string data = message.dump_message();
+		check(write(master_fd, data.data(), data.size()) == static_cast<ssize_t>(data.size()), "the device's message is written");
+	}
+
+	// the next message the server wrote, if it came before the timeout
+	std::optional<json_message> receive(test_clock::duration timeout) {
+		const auto deadline = test_clock::now() + timeout;
+
+		while (true) {
+			if (auto frame = reader.next_frame()) {
+				return json_message::parse_message(frame.value());
+			}
+
+			const auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - test_clock::now());
+			if (left.count() <= 0) {
+				return std::nullopt;
+			}
+
+			pollfd pfd{ master_fd, POLLIN, 0 };
+			if (poll(&pfd, 1, static_cast<int>(left.count())) <= 0) {
+				continue;
+			}
+
+			char buffer[1024];
+			const ssize_t bytes_read = read(master_fd, buffer, sizeof(buffer));
+			if (bytes_read > 0) {
+				reader.append(std::string_view(buffer, bytes_read));
+			}
+		}
+	}
+};
+
+// waits for the messenger to report the availability of the link
+bool wait_for_availability(arduino_messenger& messenger, bool available, test_clock::duration timeout) {
+	const auto deadline = test_clock::now() + timeout;
+
+	while (test_clock::now() < deadline) {
+		while (auto message = messenger.pop_message()) {
+			if (message->type == json_message::Availability && message->payload["available"] == available) {
+				return true;
+			}
+		}
+
+		std::this_thread::sleep_for(1ms);
+	}
+
+	return false;
+}
+
+bool is_change_state(const std::optional<json_message>& message, unsigned int id) {
+	return message && message->type == json_message::ChangeState && message->payload["id"] == id;
+}
+
+// waits for the messenger to take an answer to a change_state as it's acknowledgement
+std::optional<link_telemetry::snapshot> wait_for_change_state_ack(arduino_messenger& messenger, test_clock::duration timeout) {
+	const auto deadline = test_clock::now() + timeout;
+	const std::string type = json_message::type_to_str(json_message::ChangeState);
+
+	while (test_clock::now() < deadline) {
+		link_telemetry::snapshot telemetry = messenger.get_telemetry();
+		if (telemetry.ack_latency.contains(type) && telemetry.ack_latency.at(type).count > 0) {
+			return telemetry;
+		}
+
+		std::this_thread::sleep_for(1ms);
+	}
+
+	return std::nullopt;
+}
+
+int main() {
+	const std::string link_path =
+		(std::filesystem::temp_directory_path() / ("gate_control_replug_" + std::to_string(getpid()))).string();
+
+	net::io_context io;
+	auto work = net::make_work_guard(io);
+
+	auto device = std::make_unique<fake_device>(link_path);
+
+	auto messenger = std::make_shared<arduino_messenger>(io, link_path);
+	messenger->set_gate_ids({ 0, 1 });
+	messenger->set_device_config({ { "progressInterval", 0 } });
+	messenger->run();
+
+	std::thread io_thread([&io] { io.run(); });
+
+	const auto config = device->receive(RECEIVE_TIMEOUT);
+	check(config && config->type == json_message::Config, "the device is configured on connect");
+
+	// the device never answers, so the command is replayed after the reconnect
+	messenger->send_message(json_message(json_message::ChangeState, { { "id", 0 }, { "state", true } }), Urgent, "operator");
+	check(is_change_state(device->receive(RECEIVE_TIMEOUT), 0), "the command is written");
+
+	const auto unplug_time = test_clock::now();
+	device->unplug();
+
+	check(wait_for_availability(*messenger, false, RECEIVE_TIMEOUT), "the lost link is reported");
+	std::cout
+		<< "Link loss detected in "
+		<< std::chrono::duration_cast<std::chrono::milliseconds>(test_clock::now() - unplug_time).count()
+		<< " ms." << std::endl;
+
+	std::this_thread::sleep_for(UNPLUGGED_TIME);
+
+	// queued while the link is down, so it has to wait for the resync
+	messenger->send_message(json_message(json_message::ChangeState, { { "id", 1 }, { "state", false } }), Urgent, "operator");
+
+	const auto replug_time = test_clock::now();
+	device = std::make_unique<fake_device>(link_path);
+
+	// the device is configured, gets the command it may have missed and is queried,
+	// before anything queued meanwhile
+	const auto resync_config = device->receive(RECEIVE_TIMEOUT);
+	check(resync_config && resync_config->type == json_message::Config, "the device is configured again first");
+
+	check(is_change_state(device->receive(RECEIVE_TIMEOUT), 0), "the unanswered command is replayed");
+
+	// this time the device answers with the gate that started moving
+	device->send(json_message(json_message::QueryStateResult, nlohmann::json::array({ { { "id", 0 }, { "state", "raising" } } })));
+
+	const auto query = device->receive(RECEIVE_TIMEOUT);
+	const auto recovery_time = std::chrono::duration_cast<std::chrono::milliseconds>(test_clock::now() - replug_time);
+	check(
+		query && query->type == json_message::QueryState && query->payload == nlohmann::json({ 0, 1 }),
+		"the state of every gate is queried after the replay"
+	);
+
+	check(is_change_state(device->receive(RECEIVE_TIMEOUT), 1), "the command queued while unplugged follows the resync");
+	check(wait_for_availability(*messenger, true, RECEIVE_TIMEOUT), "the restored link is reported");
+
+	std::cout << "Resynced " << recovery_time.count() << " ms after the replug." << std::endl;
+	check(recovery_time < MAX_RECOVERY_TIME, "the device is resynced within the reconnect backoff");
+
+	const auto telemetry = wait_for_change_state_ack(*messenger, RECEIVE_TIMEOUT);
+	check(telemetry.has_value(), "the answer to the replayed command is acknowledged");
+	if (telemetry) {
+		std::cout << "Link telemetry after the replug: " << telemetry->to_json().dump() << std::endl;
+
+		check(telemetry->reconnects == 1, "the replug is counted as a reconnect");
+		check(telemetry->available, "the link is reported as available");
+		check(telemetry->bytes_sent > 0, "the bytes written to the device are counted");
+		check(telemetry->bytes_received > 0, "the bytes read from the device are counted");
+		check(telemetry->device_errors == 0, "the device reported no errors");
+		check(telemetry->unanswered_commands == 0, "no command was passed over by an answer");
+
+		// the replayed command's round trip starts at the replay, not before the outage
+		const auto& ack = telemetry->ack_latency.at(json_message::type_to_str(json_message::ChangeState));
+		check(ack.max < UNPLUGGED_TIME, "the outage isn't counted in the round trip of the replayed command");
+	}
+
+	io.stop();
+	io_thread.join();
+
+	return test_result();
+}
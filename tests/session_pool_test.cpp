@@ -0,0 +1,230 @@
+// Opens and closes many connections at once, like the clients reconnecting after the server comes back,
+// and checks that once the pools are warm, the new sessions take the memory and the read buffers of the finished ones.
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <chrono>
+#include <future>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/beast/http/read.hpp>
+#include <boost/beast/http/write.hpp>
+#include <boost/beast/http/string_body.hpp>
+#include <boost/beast/core/flat_buffer.hpp>
+#include <boost/beast/websocket/stream.hpp>
+
+#include "http_listener.hpp"
+#include "auth.hpp"
+
+#include "test_common.hpp"
+
+// half of the connections upgrade to WebSocket, within the SESSION_POOL_SIZE blocks a thread keeps
+const int BURST_SIZE = 32;
+const int WARMUP_BURSTS = 2;
+
+const std::string USERNAME = "tester";
+const std::string PASSWORD = "secret";
+const std::string REALM = "viewcontrol";
+
+struct digest_challenge {
+	std::string nonce;
+	std::string opaque;
+};
+
+std::string get_quoted_parameter(const std::string& field, const std::string& key) {
+	const std::size_t start = field.find(key + "=\"") + key.size() + 2;
+	return field.substr(start, field.find('"', start) - start);
+}
+
+// a page that needs authentication answers with the nonce of the client's address
+digest_challenge get_challenge(const tcp::endpoint& endpoint) {
+	net::io_context io;
+	tcp::socket socket(io);
+	socket.connect(endpoint);
+
+	http::request<http::empty_body> req{ http::verb::get, "/control/", 11 };
+	req.set(http::field::host, "localhost");
+	http::write(socket, req);
+
+	beast::flat_buffer buffer;
+	http::response<http::string_body> res;
+	http::read(socket, buffer, res);
+
+	const std::string field(res[http::field::www_authenticate]);
+	return { get_quoted_parameter(field, "nonce"), get_quoted_parameter(field, "opaque") };
+}
+
+std::string make_authorization(const digest_challenge& challenge, const std::string& uri) {
+	const std::string nc = "00000001";
+	const std::string cnonce = "0a4f113b";
+
+	const std::string ha1 = sha256_hash(USERNAME + ':' + REALM + ':' + PASSWORD);
+	const std::string ha2 = sha256_hash("GET:" + uri);
+	const std::string response = sha256_hash(ha1 + ':' + challenge.nonce + ':' + nc + ':' + cnonce + ":auth:" + ha2);
+
+	return
+		"Digest username=\"" + USERNAME + "\", realm=\"" + REALM + "\", "
+		"nonce=\"" + challenge.nonce + "\", uri=\"" + uri + "\", "
+		"qop=auth, nc=" + nc + ", cnonce=\"" + cnonce + "\", "
+		"response=\"" + response + "\", opaque=\"" + challenge.opaque + "\"";
+}
+
+// connects all of the clients first, so the server has a burst of sessions at once, then closes them
+int run_burst(const tcp::endpoint& endpoint, const std::string& authorization) {
+	net::io_context io;
+	std::vector<tcp::socket> pages;
+	std::vector<websocket::stream<tcp::socket>> sockets;
+
+	int answered = 0;
+
+	for (int i = 0; i < BURST_SIZE / 2; i++) {
+		tcp::socket& socket = pages.emplace_back(io);
+		socket.connect(endpoint);
+
+		websocket::stream<tcp::socket>& ws = sockets.emplace_back(io);
+		ws.next_layer().connect(endpoint);
+	}
+
+	for (tcp::socket& socket : pages) {
+		http::request<http::empty_body> req{ http::verb::get, "/", 11 };
+		req.set(http::field::host, "localhost");
+		http::write(socket, req);
+
+		beast::flat_buffer buffer;
+		http::response<http::string_body> res;
+		http::read(socket, buffer, res);
+
+		if (res.result() == http::status::ok) {
+			answered++;
+		}
+	}
+
+	for (websocket::stream<tcp::socket>& ws : sockets) {
+		ws.set_option(websocket::stream_base::decorator(
+			[&authorization](websocket::request_type& req) {
+				req.set(http::field::authorization, authorization);
+			}
+		));
+
+		beast::error_code ec;
+		ws.handshake("localhost", "/", ec);
+		if (!ec) {
+			answered++;
+		}
+	}
+
+	beast::error_code ec;
+	for (tcp::socket& socket : pages) {
+		socket.shutdown(tcp::socket::shutdown_both, ec);
+		socket.close(ec);
+	}
+	for (websocket::stream<tcp::socket>& ws : sockets) {
+		ws.next_layer().shutdown(tcp::socket::shutdown_both, ec);
+		ws.next_layer().close(ec);
+	}
+
+	// the sessions end once they see the connections closed
+	std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+	return answered;
+}
+
+// runs the function on the server's thread, where it's pools are
+template <class Function>
+auto run_on_server(net::io_context& io, Function function) {
+	std::packaged_task<decltype(function())()> task(function);
+	auto result = task.get_future();
+	net::post(io, [&task] { task(); });
+	return result.get();
+}
+
+int main() {
+	net::io_context io;
+
+	// the listener binds to the port it's given, so a free one is looked up first
+	tcp::endpoint endpoint;
+	{
+		tcp::acceptor probe(io, tcp::endpoint(net::ip::make_address("127.0.0.1"), 0));
+		endpoint = probe.local_endpoint();
+	}
+
+	auto config = std::make_shared<gc_config>();
+	auto devices = std::make_shared<device_pool>(io, config->devices);
+
+	auto auth_table = std::make_shared<auth_table_t>();
+	auth_table->insert({ USERNAME, auth_data(Control, {}, PASSWORD) });
+
+	std::make_shared<http_listener>(
+		io,
+		endpoint,
+		std::make_shared<asset_cache>(),
+		std::make_shared<client_config_cache>(config),
+		std::make_shared<common_state>(io, devices),
+		devices,
+		auth_table,
+		config
+	)->run();
+
+	// a single io thread, so every session uses the same thread's pools
+	std::thread server_thread([&io] {
+		auto work = net::make_work_guard(io);
+		io.run();
+	});
+
+	const std::string authorization = make_authorization(get_challenge(endpoint), "/");
+
+	for (int i = 0; i < WARMUP_BURSTS; i++) {
+		check(run_burst(endpoint, authorization) == BURST_SIZE, "every connection of a warm-up burst is answered");
+	}
+
+	run_on_server(io, [] {
+		get_session_pool_stats() = session_pool_stats();
+	});
+
+	check(run_burst(endpoint, authorization) == BURST_SIZE, "every connection of the measured burst is answered");
+
+	const session_pool_stats stats = run_on_server(io, [] {
+		return get_session_pool_stats();
+	});
+
+	// the finished sessions gave their read buffers back with what they grew to
+	const int kept_buffers = run_on_server(io, [] {
+		std::vector<beast::flat_buffer> buffers;
+		int kept = 0;
+
+		for (int i = 0; i < BURST_SIZE; i++) {
+			beast::flat_buffer& buffer = buffers.emplace_back(buffer_pool::take());
+			if (buffer.capacity() > 0) {
+				kept++;
+			}
+		}
+
+		for (beast::flat_buffer& buffer : buffers) {
+			buffer_pool::give_back(std::move(buffer));
+		}
+
+		return kept;
+	});
+
+	// every connection has an HTTP session, and half of them upgrade to a WebSocket one
+	const std::size_t sessions = BURST_SIZE + BURST_SIZE / 2;
+
+	std::cout
+		<< "A warm burst of " << BURST_SIZE << " connections reused "
+		<< stats.reused << " of " << sessions << " session blocks and allocated "
+		<< stats.allocated << ", " << kept_buffers << " of " << BURST_SIZE
+		<< " pooled read buffers kept their capacity." << std::endl;
+
+	check(stats.reused == sessions, "the HTTP and WebSocket sessions take the pooled blocks");
+	check(stats.allocated == 0, "no session block is allocated anew");
+	check(kept_buffers == BURST_SIZE, "the pooled read buffers keep their capacity");
+
+	io.stop();
+	server_thread.join();
+
+	return test_result();
+}
@@ -0,0 +1,22 @@
+#ifndef TEST_COMMON_HPP
+#define TEST_COMMON_HPP
+
+#include <iostream>
+#include <string_view>
+
+// the tests are plain programs, which fail with a non-zero exit code
+// after reporting every check that didn't hold
+inline int failed_checks = 0;
+
+inline void check(bool condition, std::string_view what) {
+	if (!condition) {
+		std::cerr << "Check failed: " << what << std::endl;
+		failed_checks++;
+	}
+}
+
+inline int test_result() {
+	return failed_checks == 0 ? 0 : 1;
+}
+
+#endif